@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "btree.h"
+
+/* B+tree with optimistic lock coupling (Leis et al., "The ART of
+ * practical synchronization").
+ *
+ * Readers never write shared memory: they note a node's version, read
+ * it, and check the version again before trusting what they read,
+ * restarting from the root when it changed.  Writers upgrade the
+ * version they noted to a lock with one CAS, so a node is only modified
+ * if nobody changed it since it was read.  A full node is split on the
+ * way down (with its parent locked, so the parent always has room) and
+ * a node at most a quarter full is merged with, or refilled from, a
+ * sibling on the way down of a delete.  Unlinked nodes are marked
+ * obsolete and only freed by destroy_btree, so a stale reader never
+ * reads freed memory. */
+
+#define LOCKED   2UL
+#define OBSOLETE 1UL
+
+#define LEAF_MIN  ((int) BT_LEAF_CAP / 4)
+#define INNER_MIN ((int) BT_INNER_CAP / 4)
+
+static bt_node* new_node(int leaf) {
+    bt_node* node = aligned_alloc(BT_CACHE_LINE, BT_NODE_BYTES);
+    atomic_init(&node->version, 0);
+    node->leaf = leaf;
+    node->count = 0;
+    return node;
+}
+
+/* Wait until node is unlocked and note its version.  Returns 0 if the
+ * node has been unlinked. */
+static int read_lock(bt_node* node, unsigned long* v_p) {
+    unsigned long v;
+    int spins = 0;
+
+    while ((v = atomic_load_explicit(&node->version, memory_order_acquire)) & LOCKED)
+        if (++spins > 16) sched_yield();
+    *v_p = v;
+    return !(v & OBSOLETE);
+}
+
+/* Like read_lock, but gives up at once if the node is locked */
+static int try_read_lock(bt_node* node, unsigned long* v_p) {
+    *v_p = atomic_load_explicit(&node->version, memory_order_acquire);
+    return !(*v_p & (LOCKED | OBSOLETE));
+}
+
+/* 1 if node is still at version v, so what was read from it holds */
+static int validate(bt_node* node, unsigned long v) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&node->version, memory_order_relaxed) == v;
+}
+
+static int upgrade(bt_node* node, unsigned long v) {
+    return atomic_compare_exchange_strong(&node->version, &v, v + LOCKED);
+}
+
+static void write_unlock(bt_node* node) {
+    atomic_fetch_add_explicit(&node->version, LOCKED, memory_order_release);
+}
+
+static void write_unlock_obsolete(btree* tree, bt_node* node) {
+    bt_retired* r = malloc(sizeof(bt_retired));
+
+    atomic_fetch_add_explicit(&node->version, LOCKED + OBSOLETE, memory_order_release);
+    r->node = node;
+    pthread_mutex_lock(&tree->retire_mutex);
+    r->next = tree->retired;
+    tree->retired = r;
+    pthread_mutex_unlock(&tree->retire_mutex);
+}
+
+/* Count of a node that may be changing under an optimistic reader,
+ * kept in bounds so that the reader can't run off the node */
+static inline int read_count(const bt_node* node, int cap) {
+    int n = __atomic_load_n(&node->count, __ATOMIC_RELAXED);
+    return n < 0 ? 0 : (n > cap ? cap : n);
+}
+
+/* Index of the first key >= value in keys[0..n) */
+static inline int lower_bound(const int keys[], int n, int value) {
+    int lo = 0, hi = n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (__atomic_load_n(&keys[mid], __ATOMIC_RELAXED) < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static inline int is_full(const bt_node* node) {
+    return node->leaf ? read_count(node, BT_LEAF_CAP) == (int) BT_LEAF_CAP
+                      : read_count(node, BT_INNER_CAP) == (int) BT_INNER_CAP;
+}
+
+static inline int is_underfull(const bt_node* node) {
+    return node->leaf ? read_count(node, BT_LEAF_CAP) <= LEAF_MIN
+                      : read_count(node, BT_INNER_CAP) <= INNER_MIN;
+}
+
+/* Child of inner node that holds value, and its index */
+static inline bt_node* child_of(bt_node* node, int value, int* index_p) {
+    bt_inner* in = (bt_inner*) node;
+    int i = lower_bound(in->keys, read_count(node, BT_INNER_CAP), value);
+
+    *index_p = i;
+    return __atomic_load_n(&in->children[i], __ATOMIC_RELAXED);
+}
+
+/* Split full node in two.  Caller holds node and its parent (NULL for
+ * the root). */
+static void split(btree* tree, bt_node* parent, bt_node* node) {
+    bt_node* right = new_node(node->leaf);
+    bt_inner* in;
+    int sep, half, pos;
+
+    if (node->leaf) {
+        bt_leaf* l = (bt_leaf*) node;
+        bt_leaf* r = (bt_leaf*) right;
+        half = node->count / 2;
+        r->h.count = node->count - half;
+        memcpy(r->keys, &l->keys[half], r->h.count*sizeof(int));
+        node->count = half;
+        sep = l->keys[half - 1];
+    } else {
+        bt_inner* l = (bt_inner*) node;
+        bt_inner* r = (bt_inner*) right;
+        half = node->count / 2;
+        sep = l->keys[half];
+        r->h.count = node->count - half - 1;
+        memcpy(r->keys, &l->keys[half + 1], r->h.count*sizeof(int));
+        memcpy(r->children, &l->children[half + 1], (r->h.count + 1)*sizeof(bt_node*));
+        node->count = half;
+    }
+
+    if (parent == NULL) {
+        in = (bt_inner*) new_node(0);
+        in->keys[0] = sep;
+        in->children[0] = node;
+        in->children[1] = right;
+        in->h.count = 1;
+        atomic_store(&tree->root, &in->h);
+    } else {
+        in = (bt_inner*) parent;
+        pos = lower_bound(in->keys, in->h.count, sep);
+        memmove(&in->keys[pos + 1], &in->keys[pos], (in->h.count - pos)*sizeof(int));
+        memmove(&in->children[pos + 2], &in->children[pos + 1],
+                (in->h.count - pos)*sizeof(bt_node*));
+        in->keys[pos] = sep;
+        in->children[pos + 1] = right;
+        in->h.count++;
+    }
+}
+
+/* Move one entry from right to left (to_left) or from left to right,
+ * through separator sep of parent */
+static void rotate(bt_inner* parent, int sep, bt_node* left, bt_node* right, int to_left) {
+    if (left->leaf) {
+        bt_leaf* l = (bt_leaf*) left;
+        bt_leaf* r = (bt_leaf*) right;
+        if (to_left) {
+            l->keys[l->h.count++] = r->keys[0];
+            memmove(r->keys, &r->keys[1], --r->h.count*sizeof(int));
+        } else {
+            memmove(&r->keys[1], r->keys, r->h.count++*sizeof(int));
+            r->keys[0] = l->keys[--l->h.count];
+        }
+        parent->keys[sep] = l->keys[l->h.count - 1];
+    } else {
+        bt_inner* l = (bt_inner*) left;
+        bt_inner* r = (bt_inner*) right;
+        if (to_left) {
+            l->keys[l->h.count] = parent->keys[sep];
+            l->children[++l->h.count] = r->children[0];
+            parent->keys[sep] = r->keys[0];
+            r->h.count--;
+            memmove(r->keys, &r->keys[1], r->h.count*sizeof(int));
+            memmove(r->children, &r->children[1], (r->h.count + 1)*sizeof(bt_node*));
+        } else {
+            memmove(&r->keys[1], r->keys, r->h.count*sizeof(int));
+            memmove(&r->children[1], r->children, (r->h.count + 1)*sizeof(bt_node*));
+            r->keys[0] = parent->keys[sep];
+            r->children[0] = l->children[l->h.count];
+            r->h.count++;
+            parent->keys[sep] = l->keys[--l->h.count];
+        }
+    }
+}
+
+/* Merge right into left, or even them out if they don't fit in one
+ * node.  Caller holds parent, left and right; returns 1 if right was
+ * merged (and has to be unlinked). */
+static int rebalance(bt_inner* parent, int sep, bt_node* left, bt_node* right) {
+    int moves;
+
+    if (left->leaf && left->count + right->count <= (int) BT_LEAF_CAP) {
+        bt_leaf* l = (bt_leaf*) left;
+        memcpy(&l->keys[l->h.count], ((bt_leaf*) right)->keys, right->count*sizeof(int));
+        l->h.count += right->count;
+    } else if (!left->leaf && left->count + right->count + 1 <= (int) BT_INNER_CAP) {
+        bt_inner* l = (bt_inner*) left;
+        bt_inner* r = (bt_inner*) right;
+        l->keys[l->h.count] = parent->keys[sep];
+        memcpy(&l->keys[l->h.count + 1], r->keys, r->h.count*sizeof(int));
+        memcpy(&l->children[l->h.count + 1], r->children, (r->h.count + 1)*sizeof(bt_node*));
+        l->h.count += r->h.count + 1;
+    } else {
+        moves = (right->count - left->count) / 2;
+        for (; moves > 0; moves--) rotate(parent, sep, left, right, 1);
+        for (; moves < 0; moves++) rotate(parent, sep, left, right, 0);
+        return 0;
+    }
+
+    memmove(&parent->keys[sep], &parent->keys[sep + 1],
+            (parent->h.count - sep - 1)*sizeof(int));
+    memmove(&parent->children[sep + 1], &parent->children[sep + 2],
+            (parent->h.count - sep - 1)*sizeof(bt_node*));
+    parent->h.count--;
+    return 1;
+}
+
+void init_btree(btree* tree) {
+    atomic_init(&tree->root, new_node(1));
+    pthread_mutex_init(&tree->retire_mutex, NULL);
+    tree->retired = NULL;
+}
+
+static void free_subtree(bt_node* node) {
+    int i;
+
+    if (!node->leaf)
+        for (i = 0; i <= node->count; i++)
+            free_subtree(((bt_inner*) node)->children[i]);
+    free(node);
+}
+
+void destroy_btree(btree* tree) {
+    bt_retired* r;
+
+    free_subtree(atomic_load(&tree->root));
+    while (tree->retired != NULL) {
+        r = tree->retired;
+        tree->retired = r->next;
+        free(r->node);
+        free(r);
+    }
+    pthread_mutex_destroy(&tree->retire_mutex);
+}
+
+int btree_member(btree* tree, int value) {
+    bt_node* node;
+    bt_node* child;
+    unsigned long v, cv;
+    int i, n, found;
+
+restart:
+    node = atomic_load(&tree->root);
+    if (!read_lock(node, &v) || node != atomic_load(&tree->root)) goto restart;
+    while (!node->leaf) {
+        child = child_of(node, value, &i);
+        if (!validate(node, v)) goto restart;
+        if (!read_lock(child, &cv) || !validate(node, v)) goto restart;
+        node = child;
+        v = cv;
+    }
+
+    n = read_count(node, BT_LEAF_CAP);
+    i = lower_bound(((bt_leaf*) node)->keys, n, value);
+    found = i < n && __atomic_load_n(&((bt_leaf*) node)->keys[i], __ATOMIC_RELAXED) == value;
+    if (!validate(node, v)) goto restart;
+    return found;
+}
+
+int btree_insert(btree* tree, int value) {
+    bt_node* node;
+    bt_node* parent;
+    bt_node* child;
+    bt_leaf* leaf;
+    unsigned long v, pv = 0;
+    int i;
+
+restart:
+    parent = NULL;
+    node = atomic_load(&tree->root);
+    if (!read_lock(node, &v) || node != atomic_load(&tree->root)) goto restart;
+    for (;;) {
+        if (is_full(node)) {
+            if (parent != NULL && !upgrade(parent, pv)) goto restart;
+            if (!upgrade(node, v)) {
+                if (parent != NULL) write_unlock(parent);
+                goto restart;
+            }
+            split(tree, parent, node);
+            write_unlock(node);
+            if (parent != NULL) write_unlock(parent);
+            goto restart;
+        }
+        if (node->leaf) break;
+
+        child = child_of(node, value, &i);
+        if (!validate(node, v)) goto restart;
+        parent = node;
+        pv = v;
+        node = child;
+        if (!read_lock(node, &v) || !validate(parent, pv)) goto restart;
+    }
+
+    leaf = (bt_leaf*) node;
+    i = lower_bound(leaf->keys, read_count(node, BT_LEAF_CAP), value);
+    if (i < read_count(node, BT_LEAF_CAP) &&
+            __atomic_load_n(&leaf->keys[i], __ATOMIC_RELAXED) == value) {
+        if (!validate(node, v)) goto restart;
+        return 0;
+    }
+    if (!upgrade(node, v)) goto restart;
+    memmove(&leaf->keys[i + 1], &leaf->keys[i], (node->count - i)*sizeof(int));
+    leaf->keys[i] = value;
+    node->count++;
+    write_unlock(node);
+    return 1;
+}
+
+int btree_delete(btree* tree, int value) {
+    bt_node* node;
+    bt_node* parent;
+    bt_node* child;
+    bt_node* sibling;
+    bt_node* left;
+    bt_node* right;
+    bt_inner* in;
+    bt_leaf* leaf;
+    unsigned long v, pv = 0, sv;
+    int i, index = 0, sep, merged;
+
+restart:
+    parent = NULL;
+    node = atomic_load(&tree->root);
+    if (!read_lock(node, &v) || node != atomic_load(&tree->root)) goto restart;
+    for (;;) {
+        if (parent != NULL && is_underfull(node)) {
+            if (!upgrade(parent, pv)) goto restart;
+            if (!upgrade(node, v)) {
+                write_unlock(parent);
+                goto restart;
+            }
+            in = (bt_inner*) parent;
+            sep = index < parent->count ? index : index - 1;
+            sibling = in->children[index < parent->count ? index + 1 : index - 1];
+            if (!try_read_lock(sibling, &sv) || !upgrade(sibling, sv)) {
+                write_unlock(node);
+                write_unlock(parent);
+                goto restart;
+            }
+            left = sep == index ? node : sibling;
+            right = sep == index ? sibling : node;
+
+            merged = rebalance(in, sep, left, right);
+            if (merged && parent->count == 0 && parent == atomic_load(&tree->root)) {
+                /* The root is down to one child, which becomes the root */
+                atomic_store(&tree->root, left);
+                write_unlock_obsolete(tree, right);
+                write_unlock(left);
+                write_unlock_obsolete(tree, parent);
+            } else {
+                if (merged)
+                    write_unlock_obsolete(tree, right);
+                else
+                    write_unlock(right);
+                write_unlock(left);
+                write_unlock(parent);
+            }
+            goto restart;
+        }
+        if (node->leaf) break;
+
+        child = child_of(node, value, &index);
+        if (!validate(node, v)) goto restart;
+        parent = node;
+        pv = v;
+        node = child;
+        if (!read_lock(node, &v) || !validate(parent, pv)) goto restart;
+    }
+
+    leaf = (bt_leaf*) node;
+    i = lower_bound(leaf->keys, read_count(node, BT_LEAF_CAP), value);
+    if (i >= read_count(node, BT_LEAF_CAP) ||
+            __atomic_load_n(&leaf->keys[i], __ATOMIC_RELAXED) != value) {
+        if (!validate(node, v)) goto restart;
+        return 0;
+    }
+    if (!upgrade(node, v)) goto restart;
+    memmove(&leaf->keys[i], &leaf->keys[i + 1], (node->count - i - 1)*sizeof(int));
+    node->count--;
+    write_unlock(node);
+    return 1;
+}
+
+static void subtree_stats(bt_node* node, long* keys_p, long* nodes_p) {
+    int i;
+
+    (*nodes_p)++;
+    if (node->leaf) {
+        *keys_p += node->count;
+    } else {
+        for (i = 0; i <= node->count; i++)
+            subtree_stats(((bt_inner*) node)->children[i], keys_p, nodes_p);
+    }
+}
+
+/* Keys and nodes in the tree; only while no other thread uses it */
+void btree_stats(btree* tree, long* keys_p, long* nodes_p) {
+    *keys_p = *nodes_p = 0;
+    subtree_stats(atomic_load(&tree->root), keys_p, nodes_p);
+}
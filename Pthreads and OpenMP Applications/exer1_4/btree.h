@@ -0,0 +1,56 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* Bytes per node, a multiple of the cache line size */
+#ifndef BT_NODE_BYTES
+#define BT_NODE_BYTES 512
+#endif
+#define BT_CACHE_LINE 64
+#define BT_HEADER     (sizeof(atomic_ulong) + 2*sizeof(int))
+#define BT_LEAF_CAP   ((BT_NODE_BYTES - BT_HEADER) / sizeof(int))
+#define BT_INNER_CAP  ((BT_NODE_BYTES - BT_HEADER - sizeof(void*)) / \
+                       (sizeof(int) + sizeof(void*)))
+
+/* Every node starts with a version word: bit 1 is set while a writer
+ * holds the node, bit 0 once the node has been unlinked, and each write
+ * moves the version on. */
+typedef struct {
+    atomic_ulong version;
+    int leaf;
+    int count;
+} bt_node;
+
+typedef struct {
+    bt_node h;
+    int keys[BT_LEAF_CAP];
+} bt_leaf;
+
+/* children[i] holds the keys k with keys[i-1] < k <= keys[i] */
+typedef struct {
+    bt_node h;
+    int keys[BT_INNER_CAP];
+    bt_node* children[BT_INNER_CAP + 1];
+} bt_inner;
+
+typedef struct bt_retired {
+    bt_node* node;
+    struct bt_retired* next;
+} bt_retired;
+
+typedef struct {
+    _Atomic(bt_node*) root;
+    pthread_mutex_t retire_mutex;
+    bt_retired* retired;
+} btree;
+
+void init_btree(btree* tree);
+void destroy_btree(btree* tree);
+int  btree_insert(btree* tree, int value);
+int  btree_member(btree* tree, int value);
+int  btree_delete(btree* tree, int value);
+void btree_stats(btree* tree, long* keys_p, long* nodes_p);
+
+#endif // BTREE_H
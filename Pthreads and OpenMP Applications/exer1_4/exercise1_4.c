@@ -6,12 +6,16 @@
  * 
  * Compile:  make all (needs timer.h, my_rand.h and rwlocks.h)
  *           
- * Run:      make run ARGS="<thread_count> <search_percent> <insert_percent> <approach>"
+ * Run:      make run ARGS="[options] <thread_count> <search_percent> <insert_percent> <approach> [structure] [batch_size]"
  *
- * Input:    total number of keys inserted by main thread
- *           total number of ops of each type carried out by each thread.
+ * Input:    total number of keys inserted by main thread (-i)
+ *           total number of ops carried out by all threads (-o)
+ *           key range (-k) and key distribution (-d, -t, -f, -p)
+ *           warm-up ops run before the measured ops (-w)
  *
- * Output:   Elapsed time to carry out the ops
+ * Output:   Elapsed time to carry out the ops, throughput, cache
+ *           misses per op (where hardware counters are available)
+ *           and p50/p99/p99.9 latency per op type (Latency1_4.csv)
  *
  * Notes:
  *    1.  Repeated values are not allowed in the list
@@ -22,6 +26,43 @@
  *        uses a simple linear congruential generator.
  *    5.  -DOUTPUT flag to gcc will show list before and after
  *        threads have worked on it.
+ *    6.  -DFUTEX_RWLOCK selects the futex based rw_lock (Linux only);
+ *        "make" builds it as exercise1_4_futex.
+ *    7.  Approach 3 runs Member without locks: a lookup validates
+ *        against list_version and only takes the read lock after
+ *        OPT_RETRIES failed attempts.  Deleted nodes go to a free
+ *        list instead of free() so that a racing lookup only ever
+ *        reads list nodes.
+ *    8.  The optional structure argument runs approaches 0-2 on the
+ *        classic list (0, default), on the unrolled list (1) of
+ *        unrolled_list.c, on the lock-striped hash set (2) of
+ *        hash_set.c, on the copy-on-write sorted array (3) of
+ *        sorted_array.c or on the B+tree (4) of btree.c.
+ *    9.  Approach 4 runs the ops without the global rw_lock and is only
+ *        valid for structures that synchronise internally (the hash set,
+ *        the sorted array and the B+tree, whose lookups take no locks).
+ *   10.  The classic list is built with Bulk_load (sort, link once).
+ *        Approach 5 has each thread collect batch_size ops and apply
+ *        them with Apply_batch: one sorted traversal under a single
+ *        lock acquisition.
+ *   11.  Approach 6 flat-combines inserts and deletes: a writer
+ *        publishes its op in its fc_slots entry and whichever writer
+ *        gets fc_lock applies every published op with Apply_batch
+ *        under one write lock.  Lookups take the read lock as usual.
+ *   12.  Keys of the measured ops come from workload.c: uniform (the
+ *        default, same keys as before), Zipfian or hot-set.  The
+ *        initial keys are always uniform.  Each thread runs its share
+ *        of the -w warm-up ops, then all threads meet at a barrier and
+ *        the timed phase starts.  Latencies are taken per op with
+ *        CLOCK_MONOTONIC into per-thread latency_hist buckets.
+ *   13.  Approach 7 runs approaches 1-2 on the phase-fair pf_rwlock,
+ *        which bounds how long a writer waits behind a reader stream;
+ *        compare its Latency1_4.csv rows with Read_first/Write_first.
+ *   14.  Approach 8 gathers runs of consecutive lookups (up to
+ *        INTERLEAVE_GROUP) and answers each run under one read lock
+ *        with Set_member_batch, which keeps batch_size lookups in
+ *        flight and prefetches the node each one visits next.  Only
+ *        the ordered structures (list, unrolled list) support it.
  *
  * IPP:   Section 4.9.3 (pp. 187 and ff.)
  */
@@ -30,13 +71,56 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sched.h>
+#include <getopt.h>
 #include "../timer.h"
 #include "../my_rand.h"
 #include "rwlocks.h"
+#include "unrolled_list.h"
+#include "hash_set.h"
+#include "sorted_array.h"
+#include "btree.h"
+#include "workload.h"
+#include "latency_hist.h"
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
 
-/* Random ints are less than MAX_KEY */
+/* CSV label suffix for the rw_lock implementation in use */
+#ifdef FUTEX_RWLOCK
+#define LOCK_IMPL "_futex"
+#else
+#define LOCK_IMPL ""
+#endif
+
+/* Random ints are less than MAX_KEY unless -k says otherwise */
 const int MAX_KEY = 100000000;
 
+/* Workload defaults, see Usage */
+#define DEFAULT_INSERTS_IN_MAIN 1000
+#define DEFAULT_TOTAL_OPS       500000
+#define DEFAULT_ZIPF_THETA      0.99
+#define DEFAULT_HOT_FRACTION    0.01
+#define DEFAULT_HOT_OP_FRACTION 0.9
+
+/* Optimistic lookups: attempts before falling back to the read lock, */
+/* and how many nodes are visited between early version checks        */
+#define OPT_RETRIES        8
+#define OPT_CHECK_INTERVAL 256
+
+/* Batch size for approach 5 (interleave width for approach 8) */
+/* unless given on the command line                              */
+#define DEFAULT_BATCH_SIZE 16
+
+/* Approach 8: most lookups answered by one Set_member_batch call, */
+/* and most lookups Member_batch keeps in flight                   */
+#define INTERLEAVE_GROUP   256
+#define MAX_INTERLEAVE     64
+
 
 /* Struct for list nodes */
 struct list_node_s {
@@ -45,6 +129,29 @@ struct list_node_s {
 };
 
 
+/* Pending op for Apply_batch */
+typedef enum {
+   OP_MEMBER,
+   OP_INSERT,
+   OP_DELETE
+} Op_type;
+
+typedef struct {
+   int      value;
+   Op_type  type;
+   int      seq;      /* submission order, breaks ties on equal keys */
+   int      result;
+} batch_op;
+
+/* Per-thread publication slot for flat combining */
+typedef struct {
+   atomic_int pending;   /* 1 until a combiner has applied the op */
+   int        value;
+   Op_type    type;
+   int        result;
+} __attribute__((aligned(64))) fc_slot;
+
+
 /* Shared variables */
 struct      list_node_s* head = NULL;  
 int         thread_count;
@@ -53,36 +160,154 @@ double      insert_percent;
 double      search_percent;
 double      delete_percent;
 rw_lock     rwlock;
+pf_rwlock   pflock;
 pthread_mutex_t     count_mutex;
 
+/* Workload: key generator, warm-up ops and the barrier that starts */
+/* the measured phase                                               */
+workload    wl;
+int         key_range = 100000000;
+int         warmup_ops = 0;
+const char* dist_suffix = "";
+pthread_barrier_t   phase_barrier;
+/* Latency of the measured ops, per Op_type, merged under count_mutex */
+latency_hist        op_latency[3];
+
+/* Seqlock version, odd while a writer is changing the list */
+atomic_uint list_version;
+/* Deleted nodes, reused by Insert (protected by the write lock) */
+struct      list_node_s* free_nodes = NULL;
+/* Optimistic lookup counters, summed under count_mutex */
+long        optimistic_lookups, optimistic_retries, optimistic_fallbacks;
+
+/* Set the ops run against: the classic list unless a structure */
+/* argument selects another one                                 */
+int         (*Set_insert)(int value);
+int         (*Set_member)(int value);
+int         (*Set_delete)(int value);
+void        (*Set_free)(void);
+/* Interleaved lookups, NULL for structures without them */
+void        (*Set_member_batch)(const int values[], int results[],
+                                int count, int width);
+const char* structure_suffix = "";
+unrolled_list ulist;
+hash_set    hset;
+sorted_array sset;
+btree       bptree;
+
+/* Approach 5: ops per batch and batch latencies, summed under count_mutex */
+int         batch_size = DEFAULT_BATCH_SIZE;
+double      batch_latency_sum;
+long        batch_count;
+
+/* Approach 6: published ops and the combiner lock; the counters */
+/* are only written by the thread holding fc_lock, and only once  */
+/* fc_measuring is set                                            */
+fc_slot*    fc_slots;
+batch_op*   fc_batch;
+atomic_int  fc_lock, fc_measuring;
+long        fc_passes, fc_combined;
+
+/* Approach 8: lookups and the time spent answering them, summed */
+/* under count_mutex                                             */
+long        interleave_lookups;
+double      interleave_time;
+
 /* Setup and cleanup */
 void        Usage(char* prog_name);
 void        Get_input(int* inserts_in_main_p);
 void        output_csv(FILE *fp, const char* label, double elapsed_time);
+void        Select_structure(int structure);
+void        Select_distribution(const char* name, double theta,
+                                double hot_fraction, double hot_op_fraction);
+int         Cache_counter_open(void);
+void        Cache_counter_start(int fd);
+long long   Cache_counter_stop(int fd);
+void        Report_run(int ops, double elapsed, long long cache_misses);
+void        Report_memory(int structure);
+void        Report_latencies(const char* label);
+
+/* Op generation and per-thread measurement helpers */
+Op_type     Next_op(unsigned* seed_p, int* val_p);
+void        Start_measurement(void);
+latency_hist*  Alloc_latencies(void);
+void        Merge_latencies(latency_hist* lat);
 
-/* Thread functions for approaches A and B*/
+/* Thread functions for approaches A to H */
 void*       Thread_workA(void* rank);
 void*       Thread_workB(void* rank);
-void        run_parallel_approach(void* (*thread_func)(void*), 
+void*       Thread_workC(void* rank);
+void*       Thread_workD(void* rank);
+void*       Thread_workE(void* rank);
+void*       Thread_workF(void* rank);
+void*       Thread_workG(void* rank);
+void*       Thread_workH(void* rank);
+double      run_parallel_approach(void* (*thread_func)(void*), 
                                              const char* label, FILE *fp);
 
 /* List operations */
 int         Insert(int value);
 void        Print(void);
 int         Member(int value);
+void        Member_batch(const int values[], int results[], int count, int width);
 int         Delete(int value);
 void        Free_list(void);
 int         Is_empty(void);
+int         Member_optimistic(int value, long* retries_p, long* fallbacks_p);
+void        Write_begin(void);
+void        Write_end(void);
+struct      list_node_s* Alloc_node(void);
+void        Retire_node(struct list_node_s* node);
+int         Compare_ints(const void* a, const void* b);
+int         Compare_batch_ops(const void* a, const void* b);
+int         Sort_unique(int keys[], int count);
+int         Bulk_load(int keys[], int count);
+void        Apply_batch(batch_op ops[], int count);
+int         Fc_submit(long my_rank, Op_type type, int value);
+void        Fc_combine(void);
+
+/* Unrolled list operations on ulist */
+int         Unrolled_insert(int value);
+int         Unrolled_member(int value);
+void        Unrolled_member_batch(const int values[], int results[],
+                                  int count, int width);
+int         Unrolled_delete(int value);
+void        Unrolled_free(void);
+
+/* Hash set operations on hset */
+int         Hash_insert(int value);
+int         Hash_member(int value);
+int         Hash_delete(int value);
+void        Hash_free(void);
+
+/* Sorted array operations on sset */
+int         Sorted_insert(int value);
+int         Sorted_member(int value);
+int         Sorted_delete(int value);
+void        Sorted_free(void);
+
+/* B+tree operations on bptree */
+int         Btree_insert(int value);
+int         Btree_member(int value);
+int         Btree_delete(int value);
+void        Btree_free(void);
 
 /*-----------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
    long i; 
-   int key, success, attempts;
-   int approach;
-   int inserts_in_main;
+   int key, success, attempts, draws;
+   int* keys;
+   int approach, structure, opt;
+   int inserts_in_main = DEFAULT_INSERTS_IN_MAIN;
+   int counter_fd;
+   const char* dist_name = "uniform";
+   double theta = DEFAULT_ZIPF_THETA;
+   double hot_fraction = DEFAULT_HOT_FRACTION;
+   double hot_op_fraction = DEFAULT_HOT_OP_FRACTION;
    unsigned seed = 1;
    double start, finish, elapsed;
 
+   atomic_init(&list_version, 0);
    FILE *fp = fopen("Results1_4.csv", "a");
    if (fp == NULL) {
       perror("Error opening file");
@@ -90,24 +315,71 @@ int main(int argc, char* argv[]) {
    }
    /*csv records: approach, threads, search_percent, insert_percent, delete_percent, elapsed_time */
 
-   if (argc != 5) Usage(argv[0]);
+   total_ops = DEFAULT_TOTAL_OPS;
+   while ((opt = getopt(argc, argv, "i:o:k:w:d:t:f:p:")) != -1) {
+      switch (opt) {
+         case 'i': inserts_in_main = strtol(optarg,NULL,10); break;
+         case 'o': total_ops = strtol(optarg,NULL,10); break;
+         case 'k': key_range = strtol(optarg,NULL,10); break;
+         case 'w': warmup_ops = strtol(optarg,NULL,10); break;
+         case 'd': dist_name = optarg; break;
+         case 't': theta = strtod(optarg,NULL); break;
+         case 'f': hot_fraction = strtod(optarg,NULL); break;
+         case 'p': hot_op_fraction = strtod(optarg,NULL); break;
+         default: Usage(argv[0]);
+      }
+   }
+   /* Positional arguments as before, with argv[0] kept in front */
+   argv[optind - 1] = argv[0];
+   argc -= optind - 1;
+   argv += optind - 1;
+
+   if (argc < 5 || argc > 7) Usage(argv[0]);
    thread_count = strtol(argv[1],NULL,10);
    search_percent = strtod(argv[2],NULL);
    insert_percent = strtod(argv[3],NULL);
    approach = strtol(argv[4],NULL,10);
+   structure = (argc >= 6) ? strtol(argv[5],NULL,10) : 0;
+   if (argc == 7) batch_size = strtol(argv[6],NULL,10);
+   if (batch_size <= 0) Usage(argv[0]);
+   if (thread_count <= 0 || total_ops < thread_count || key_range <= 0 ||
+       inserts_in_main < 0 || warmup_ops < 0) Usage(argv[0]);
+   if (structure != 0 && (approach == 3 || approach == 5 || approach == 6))
+      Usage(argv[0]);
+   if (structure < 2 && approach == 4) Usage(argv[0]);
+   if (structure >= 2 && approach == 8) Usage(argv[0]);
+   Select_structure(structure);
+   Select_distribution(dist_name, theta, hot_fraction, hot_op_fraction);
    delete_percent = 1.0 - (search_percent + insert_percent);
 
-   inserts_in_main = 1000;
-   total_ops = 500000;
-
    /* Try to insert inserts_in_main keys, but give up after */
    /* 2*inserts_in_main attempts.                           */
    i = attempts = 0;
-   while ( i < inserts_in_main && attempts < 2*inserts_in_main ) {
-      key = my_rand(&seed) % MAX_KEY;
-      success = Insert(key);
-      attempts++;
-      if (success) i++;
+   if (structure == 0 || structure == 3) {
+      /* Draw only as many keys as are still missing, so the set */
+      /* ends up with the same keys as inserting one at a time   */
+      keys = malloc(2*inserts_in_main*sizeof(int));
+      while ( i < inserts_in_main && attempts < 2*inserts_in_main ) {
+         draws = inserts_in_main - i;
+         if (draws > 2*inserts_in_main - attempts)
+            draws = 2*inserts_in_main - attempts;
+         for (int d = 0; d < draws; d++)
+            keys[i + d] = my_rand(&seed) % key_range;
+         attempts += draws;
+         i = Sort_unique(keys, i + draws);
+      }
+      if (structure == 0)
+         Bulk_load(keys, i);
+      else
+         sorted_bulk_load(&sset, keys, i);
+      free(keys);
+   } else {
+      while ( i < inserts_in_main && attempts < 2*inserts_in_main ) {
+         key = my_rand(&seed) % key_range;
+         success = Set_insert(key);
+         attempts++;
+         if (success) i++;
+      }
    }
    printf("Inserted %ld keys in empty list\n", i);
 
@@ -120,54 +392,110 @@ int main(int argc, char* argv[]) {
 if (approach == 0){
    /*Serial Approach*/
    int val;
-   double which_op;
+   Op_type op;
+   unsigned long t0;
 
-   GET_TIME(start);
-   for (int k = 0; k < total_ops; k++) {
+   counter_fd = Cache_counter_open();
+   for (int k = -warmup_ops; k < total_ops; k++) {
+         if (k == 0) {
+            Cache_counter_start(counter_fd);
+            GET_TIME(start);
+         }
          seed= k;
-         which_op = my_drand(&seed);
-         val = my_rand(&seed) % MAX_KEY;
-         if (which_op < search_percent) {
-            Member(val);
-         } else if (which_op < search_percent + insert_percent) {
-            Insert(val);
-         } else { 
-            Delete(val);
+         op = Next_op(&seed, &val);
+         t0 = now_ns();
+         if (op == OP_MEMBER) {
+            Set_member(val);
+         } else if (op == OP_INSERT) {
+            Set_insert(val);
+         } else {
+            Set_delete(val);
          }
+         if (k >= 0) latency_record(&op_latency[op], now_ns() - t0);
    }
    GET_TIME(finish);
    elapsed = finish - start;
 	output_csv(fp, "Serial", elapsed);
    printf("Serial approach done in %e seconds\n", elapsed);
+   Report_run(total_ops, elapsed, Cache_counter_stop(counter_fd));
+   Report_latencies("Serial");
 
 }  else if (approach == 1){
-   run_parallel_approach(Thread_workA, "Read_first", fp);
+   run_parallel_approach(Thread_workA, "Read_first" LOCK_IMPL, fp);
 }  else if (approach == 2){
-   run_parallel_approach(Thread_workB, "Write_first", fp);
+   run_parallel_approach(Thread_workB, "Write_first" LOCK_IMPL, fp);
+}  else if (approach == 3){
+   elapsed = run_parallel_approach(Thread_workC, "Optimistic" LOCK_IMPL, fp);
+   printf("Optimistic lookups: %ld, retries: %ld (%.4f%%), fallbacks: %ld (%.4f%%)\n",
+          optimistic_lookups,
+          optimistic_retries, 
+          optimistic_lookups ? 100.0*optimistic_retries/optimistic_lookups : 0.0,
+          optimistic_fallbacks, 
+          optimistic_lookups ? 100.0*optimistic_fallbacks/optimistic_lookups : 0.0);
+}  else if (approach == 4){
+   run_parallel_approach(Thread_workD, "Concurrent", fp);
+}  else if (approach == 5){
+   char label[64];
+   snprintf(label, sizeof(label), "Batched%d%s", batch_size, LOCK_IMPL);
+   run_parallel_approach(Thread_workE, label, fp);
+   printf("Batch size: %d, batches: %ld, avg batch latency: %e seconds\n",
+          batch_size, batch_count, batch_count ? batch_latency_sum/batch_count : 0.0);
+}  else if (approach == 6){
+   fc_slots = aligned_alloc(64, thread_count*sizeof(fc_slot));
+   fc_batch = malloc(thread_count*sizeof(batch_op));
+   for (i = 0; i < thread_count; i++)
+      atomic_init(&fc_slots[i].pending, 0);
+   atomic_init(&fc_lock, 0);
+   atomic_init(&fc_measuring, 0);
+   run_parallel_approach(Thread_workF, "Flat_combining" LOCK_IMPL, fp);
+   printf("Combining passes: %ld, avg combining batch size: %.2f\n",
+          fc_passes, fc_passes ? (double) fc_combined/fc_passes : 0.0);
+   free(fc_slots);
+   free(fc_batch);
+}  else if (approach == 7){
+   run_parallel_approach(Thread_workG, "Phase_fair", fp);
+}  else if (approach == 8){
+   char label[64];
+   if (batch_size > MAX_INTERLEAVE) batch_size = MAX_INTERLEAVE;
+   snprintf(label, sizeof(label), "Interleaved%d%s", batch_size, LOCK_IMPL);
+   run_parallel_approach(Thread_workH, label, fp);
+   printf("Interleave width: %d, lookups: %ld, lookups/sec: %e\n",
+          batch_size, interleave_lookups,
+          interleave_time > 0.0 ? interleave_lookups/(interleave_time/thread_count) : 0.0);
 }  else Usage(argv[0]);
 
+   if (structure == 3)
+      printf("Sorted array merges: %ld\n", sset.merges);
+   Report_memory(structure);
+
 #  ifdef OUTPUT
    printf("After threads terminate, list = \n");
    Print();
    printf("\n");
 #  endif
-   Free_list();
+   Set_free();
 
    return 0;
 }  /* main */
 
 
-/* Function to run the parallel approach */
-void run_parallel_approach(void* (*thread_func)(void*), const char* label, FILE *fp) {
+/* Function to run the parallel approach, returns the elapsed time */
+double run_parallel_approach(void* (*thread_func)(void*), const char* label, FILE *fp) {
     pthread_t* thread_handles = malloc(thread_count * sizeof(pthread_t));
     pthread_mutex_init(&count_mutex, NULL);
+    pthread_barrier_init(&phase_barrier, NULL, thread_count + 1);
     init_rwlock(&rwlock);
+    init_pf_rwlock(&pflock);
     double start, finish, elapsed;
+    int counter_fd = Cache_counter_open();
 
-    GET_TIME(start);
     for (long i = 0; i < thread_count; i++) {
         pthread_create(&thread_handles[i], NULL, thread_func, (void*)i);
     }
+    /* Threads arrive here once their warm-up ops are done */
+    pthread_barrier_wait(&phase_barrier);
+    Cache_counter_start(counter_fd);
+    GET_TIME(start);
     for (long i = 0; i < thread_count; i++) {
         pthread_join(thread_handles[i], NULL);
     }
@@ -176,16 +504,261 @@ void run_parallel_approach(void* (*thread_func)(void*), const char* label, FILE
     output_csv(fp, label, elapsed);
 
     printf("Parallel %s approach done in %e seconds\n", label, elapsed);
+    Report_run((total_ops/thread_count)*thread_count, elapsed,
+               Cache_counter_stop(counter_fd));
+    Report_latencies(label);
 
     destroy_rwlock(&rwlock);
+    destroy_pf_rwlock(&pflock);
+    pthread_barrier_destroy(&phase_barrier);
     pthread_mutex_destroy(&count_mutex);
     free(thread_handles);
+    return elapsed;
 }
 
+/*-----------------------------------------------------------------*/
+/* Point the Set_* operations at the chosen structure */
+void Select_structure(int structure) {
+   if (structure == 0) {
+      Set_insert = Insert;
+      Set_member = Member;
+      Set_delete = Delete;
+      Set_free = Free_list;
+      Set_member_batch = Member_batch;
+      structure_suffix = "";
+   } else if (structure == 1) {
+      init_unrolled_list(&ulist);
+      Set_insert = Unrolled_insert;
+      Set_member = Unrolled_member;
+      Set_delete = Unrolled_delete;
+      Set_free = Unrolled_free;
+      Set_member_batch = Unrolled_member_batch;
+      structure_suffix = "_unrolled";
+   } else if (structure == 2) {
+      init_hash_set(&hset);
+      Set_insert = Hash_insert;
+      Set_member = Hash_member;
+      Set_delete = Hash_delete;
+      Set_free = Hash_free;
+      Set_member_batch = NULL;
+      structure_suffix = "_hash";
+   } else if (structure == 3) {
+      init_sorted_array(&sset);
+      Set_insert = Sorted_insert;
+      Set_member = Sorted_member;
+      Set_delete = Sorted_delete;
+      Set_free = Sorted_free;
+      Set_member_batch = NULL;
+      structure_suffix = "_sorted";
+   } else if (structure == 4) {
+      init_btree(&bptree);
+      Set_insert = Btree_insert;
+      Set_member = Btree_member;
+      Set_delete = Btree_delete;
+      Set_free = Btree_free;
+      Set_member_batch = NULL;
+      structure_suffix = "_btree";
+   } else {
+      fprintf(stderr, "Error: structure must be 0 (list), 1 (unrolled list), 2 (hash set), 3 (sorted array) or 4 (B+tree)\n");
+      exit(EXIT_FAILURE);
+   }
+}  /* Select_structure */
+
+/*-----------------------------------------------------------------*/
+/* Select the key distribution of the measured ops */
+void Select_distribution(const char* name, double theta,
+                         double hot_fraction, double hot_op_fraction) {
+   if (strcmp(name, "uniform") == 0) {
+      init_workload(&wl, DIST_UNIFORM, key_range, 0.0, 0.0, 0.0);
+      dist_suffix = "";
+   } else if (strcmp(name, "zipf") == 0) {
+      if (theta <= 0.0 || theta >= 1.0) {
+         fprintf(stderr, "Error: Zipfian theta must be between 0 and 1\n");
+         exit(EXIT_FAILURE);
+      }
+      init_workload(&wl, DIST_ZIPF, key_range, theta, 0.0, 0.0);
+      dist_suffix = "_zipf";
+   } else if (strcmp(name, "hotset") == 0) {
+      init_workload(&wl, DIST_HOTSET, key_range, 0.0, hot_fraction, hot_op_fraction);
+      dist_suffix = "_hotset";
+   } else {
+      fprintf(stderr, "Error: distribution must be uniform, zipf or hotset\n");
+      exit(EXIT_FAILURE);
+   }
+}  /* Select_distribution */
+
+/*-----------------------------------------------------------------*/
+/* Pick the next op type (by the search/insert/delete mix) and key */
+Op_type Next_op(unsigned* seed_p, int* val_p) {
+   double which_op = my_drand(seed_p);
+
+   *val_p = next_key(&wl, seed_p);
+   if (which_op < search_percent)
+      return OP_MEMBER;
+   else if (which_op < search_percent + insert_percent)
+      return OP_INSERT;
+   else
+      return OP_DELETE;
+}  /* Next_op */
+
+/*-----------------------------------------------------------------*/
+/* Called by each thread after its warm-up ops.  No thread passes */
+/* the barrier before all warm-up ops are done, so a combiner that */
+/* has set fc_measuring only combines measured ops                 */
+void Start_measurement(void) {
+   pthread_barrier_wait(&phase_barrier);
+   atomic_store_explicit(&fc_measuring, 1, memory_order_relaxed);
+}  /* Start_measurement */
+
+/*-----------------------------------------------------------------*/
+/* Thread-private histograms, one per Op_type */
+latency_hist* Alloc_latencies(void) {
+   latency_hist* lat = malloc(3*sizeof(latency_hist));
+
+   for (int t = 0; t < 3; t++)
+      init_latency_hist(&lat[t]);
+   return lat;
+}  /* Alloc_latencies */
+
+/*-----------------------------------------------------------------*/
+void Merge_latencies(latency_hist* lat) {
+   pthread_mutex_lock(&count_mutex);
+   for (int t = 0; t < 3; t++)
+      latency_merge(&op_latency[t], &lat[t]);
+   pthread_mutex_unlock(&count_mutex);
+   free(lat);
+}  /* Merge_latencies */
+
+/*-----------------------------------------------------------------*/
+/* Print p50/p99/p99.9 per op type and append them to Latency1_4.csv */
+void Report_latencies(const char* label) {
+   const char* op_names[3] = { "member", "insert", "delete" };
+   FILE* lat_fp = fopen("Latency1_4.csv", "a");
+   /*csv records: approach, threads, search_percent, insert_percent, op, count, p50_ns, p99_ns, p999_ns */
+
+   for (int t = 0; t < 3; t++) {
+      if (op_latency[t].count == 0) continue;
+      printf("%-6s latency (us): p50 %.3f  p99 %.3f  p99.9 %.3f  (%ld ops)\n",
+             op_names[t],
+             latency_percentile(&op_latency[t], 0.50)/1000.0,
+             latency_percentile(&op_latency[t], 0.99)/1000.0,
+             latency_percentile(&op_latency[t], 0.999)/1000.0,
+             op_latency[t].count);
+      if (lat_fp != NULL)
+         fprintf(lat_fp, "%s%s%s,%d,%lf,%lf,%s,%ld,%lu,%lu,%lu\n", label,
+                 structure_suffix, dist_suffix, thread_count, search_percent,
+                 insert_percent, op_names[t], op_latency[t].count,
+                 latency_percentile(&op_latency[t], 0.50),
+                 latency_percentile(&op_latency[t], 0.99),
+                 latency_percentile(&op_latency[t], 0.999));
+   }
+   if (lat_fp != NULL) fclose(lat_fp);
+}  /* Report_latencies */
+
+/*-----------------------------------------------------------------*/
+/* Open a (disabled) cache miss counter for this process and the   */
+/* threads it creates from now on.  Returns -1 when no hardware    */
+/* counter is available                                            */
+int Cache_counter_open(void) {
+#  ifdef __linux__
+   struct perf_event_attr attr;
+   int fd;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.size = sizeof(attr);
+   attr.config = PERF_COUNT_HW_CACHE_MISSES;
+   attr.disabled = 1;
+   attr.inherit = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+   return fd;
+#  else
+   return -1;
+#  endif
+}  /* Cache_counter_open */
+
+/*-----------------------------------------------------------------*/
+/* Start counting, also in threads already created */
+void Cache_counter_start(int fd) {
+#  ifdef __linux__
+   if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#  endif
+}  /* Cache_counter_start */
+
+/*-----------------------------------------------------------------*/
+/* Returns the misses counted since Cache_counter_start, or -1 */
+long long Cache_counter_stop(int fd) {
+   long long count = -1;
+
+   if (fd < 0) return -1;
+   if (read(fd, &count, sizeof(count)) != sizeof(count))
+      count = -1;
+   close(fd);
+   return count;
+}  /* Cache_counter_stop */
+
+/*-----------------------------------------------------------------*/
+void Report_run(int ops, double elapsed, long long cache_misses) {
+   printf("Throughput: %e ops/sec\n", ops/elapsed);
+   if (cache_misses >= 0)
+      printf("Cache misses per op: %.2f\n", (double) cache_misses/ops);
+   else
+      printf("Cache misses per op: n/a (no hardware counters)\n");
+}  /* Report_run */
+
+/*-----------------------------------------------------------------*/
+/* Node bytes per key of the structures that can be walked cheaply */
+void Report_memory(int structure) {
+   struct list_node_s* curr;
+   unrolled_node* unode;
+   long keys = 0, nodes = 0, bytes;
+
+   if (structure == 0) {
+      for (curr = head; curr != NULL; curr = curr->next)
+         keys++;
+      bytes = keys*sizeof(struct list_node_s);
+   } else if (structure == 1) {
+      for (unode = ulist.head; unode != NULL; unode = unode->next, nodes++)
+         keys += unode->count;
+      bytes = nodes*sizeof(unrolled_node);
+   } else if (structure == 4) {
+      btree_stats(&bptree, &keys, &nodes);
+      bytes = nodes*BT_NODE_BYTES;
+   } else {
+      return;
+   }
+   if (keys > 0)
+      printf("Memory per key: %.1f bytes (%ld keys)\n", (double) bytes/keys, keys);
+}  /* Report_memory */
+
 /*-----------------------------------------------------------------*/
 void Usage(char* program_name) {
-    fprintf(stderr, "Usage: %s <thread_count> <search_percent> <insert_percent> <approach>\n"
-                    "       0 for Serial, 1 for Parallel A, 2 for Parallel B\n", program_name);
+    fprintf(stderr, "Usage: %s [options] <thread_count> <search_percent> <insert_percent> <approach> [structure] [batch_size]\n"
+                    "       0 for Serial, 1 for Parallel A, 2 for Parallel B,\n"
+                    "       3 for Parallel with optimistic lookups,\n"
+                    "       4 for Parallel without the global lock (hash set, sorted array, B+tree),\n"
+                    "       5 for Parallel with batched ops (list only),\n"
+                    "       6 for Parallel with flat-combined writes (list only),\n"
+                    "       7 for Parallel with the phase-fair lock,\n"
+                    "       8 for Parallel with interleaved lookups (lists only)\n"
+                    "       structure: 0 for list (default), 1 for unrolled list,\n"
+                    "       2 for hash set, 3 for sorted array, 4 for B+tree\n"
+                    "       batch_size: ops per batch for approach 5, lookups in flight\n"
+                    "       for approach 8 (default %d, at most %d)\n"
+                    "Options:\n"
+                    "       -i <keys>   keys inserted before the threads start (default %d)\n"
+                    "       -o <ops>    total ops in the measured phase (default %d)\n"
+                    "       -k <range>  keys are in [0, range) (default %d)\n"
+                    "       -w <ops>    total warm-up ops before measuring (default 0)\n"
+                    "       -d <dist>   key distribution: uniform (default), zipf, hotset\n"
+                    "       -t <theta>  Zipfian skew, 0 < theta < 1 (default %.2f)\n"
+                    "       -f <frac>   hot-set size as a fraction of the key range (default %.2f)\n"
+                    "       -p <frac>   fraction of ops that go to the hot set (default %.2f)\n",
+                    program_name, DEFAULT_BATCH_SIZE, MAX_INTERLEAVE, DEFAULT_INSERTS_IN_MAIN,
+                    DEFAULT_TOTAL_OPS, MAX_KEY, DEFAULT_ZIPF_THETA,
+                    DEFAULT_HOT_FRACTION, DEFAULT_HOT_OP_FRACTION);
     exit(EXIT_FAILURE);
 }  /* Usage */
 
@@ -218,7 +791,7 @@ int Insert(int value) {
    }
 
    if (curr == NULL || curr->data > value) {
-      temp = malloc(sizeof(struct list_node_s));
+      temp = Alloc_node();
       temp->data = value;
       temp->next = curr;
       if (pred == NULL)
@@ -268,6 +841,45 @@ int  Member(int value) {
    }
 }  /* Member */
 
+/*-----------------------------------------------------------------*/
+/* Member for count values with up to width lookups in flight.     */
+/* Each round moves every lookup one node forward and prefetches   */
+/* the node it will look at next, so the cache misses of different */
+/* lookups overlap; a finished lookup's slot takes the next value. */
+void Member_batch(const int values[], int results[], int count, int width) {
+   struct list_node_s* node[MAX_INTERLEAVE];
+   int which[MAX_INTERLEAVE];
+   int s, v, next = 0, active = 0;
+
+   if (width > MAX_INTERLEAVE) width = MAX_INTERLEAVE;
+   if (width < 1) width = 1;
+   for (s = 0; s < width; s++) {
+      which[s] = next < count ? next++ : -1;
+      node[s] = head;
+      if (which[s] >= 0) active++;
+   }
+
+   while (active > 0) {
+      for (s = 0; s < width; s++) {
+         if (which[s] < 0) continue;
+         v = values[which[s]];
+         if (node[s] != NULL && node[s]->data < v) {
+            node[s] = node[s]->next;
+            if (node[s] != NULL) __builtin_prefetch(node[s]);
+            continue;
+         }
+         results[which[s]] = node[s] != NULL && node[s]->data == v;
+         if (next < count) {
+            which[s] = next++;
+            node[s] = head;
+         } else {
+            which[s] = -1;
+            active--;
+         }
+      }
+   }
+}  /* Member_batch */
+
 /*-----------------------------------------------------------------*/
 /* Deletes value from list */
 /* If value is in list, return 1, else return 0 */
@@ -288,13 +900,13 @@ int Delete(int value) {
 #        ifdef DEBUG
          printf("Freeing %d\n", value);
 #        endif
-         free(curr);
+         Retire_node(curr);
       } else { 
          pred->next = curr->next;
 #        ifdef DEBUG
          printf("Freeing %d\n", value);
 #        endif
-         free(curr);
+         Retire_node(curr);
       }
    } else { /* Not in list */
       rv = 0;
@@ -308,6 +920,12 @@ void Free_list(void) {
    struct list_node_s* current;
    struct list_node_s* following;
 
+   while (free_nodes != NULL) {
+      current = free_nodes;
+      free_nodes = current->next;
+      free(current);
+   }
+
    if (Is_empty()) return;
    current = head; 
    following = current->next;
@@ -325,6 +943,256 @@ void Free_list(void) {
    free(current);
 }  /* Free_list */
 
+/*-----------------------------------------------------------------*/
+int  Unrolled_insert(int value) { return unrolled_insert(&ulist, value); }
+int  Unrolled_member(int value) { return unrolled_member(&ulist, value); }
+void Unrolled_member_batch(const int values[], int results[], int count, int width) {
+   unrolled_member_batch(&ulist, values, results, count, width);
+}
+int  Unrolled_delete(int value) { return unrolled_delete(&ulist, value); }
+void Unrolled_free(void)        { destroy_unrolled_list(&ulist); }
+
+/*-----------------------------------------------------------------*/
+int  Hash_insert(int value) { return hash_insert(&hset, value); }
+int  Hash_member(int value) { return hash_member(&hset, value); }
+int  Hash_delete(int value) { return hash_delete(&hset, value); }
+void Hash_free(void)        { destroy_hash_set(&hset); }
+
+/*-----------------------------------------------------------------*/
+int  Sorted_insert(int value) { return sorted_insert(&sset, value); }
+int  Sorted_member(int value) { return sorted_member(&sset, value); }
+int  Sorted_delete(int value) { return sorted_delete(&sset, value); }
+void Sorted_free(void)        { destroy_sorted_array(&sset); }
+
+/*-----------------------------------------------------------------*/
+int  Btree_insert(int value) { return btree_insert(&bptree, value); }
+int  Btree_member(int value) { return btree_member(&bptree, value); }
+int  Btree_delete(int value) { return btree_delete(&bptree, value); }
+void Btree_free(void)        { destroy_btree(&bptree); }
+
+/*-----------------------------------------------------------------*/
+/* Take a node from the free list, or malloc a new one */
+struct list_node_s* Alloc_node(void) {
+   struct list_node_s* node = free_nodes;
+
+   if (node == NULL)
+      return malloc(sizeof(struct list_node_s));
+   free_nodes = node->next;
+   return node;
+}  /* Alloc_node */
+
+/*-----------------------------------------------------------------*/
+/* Keep a deleted node for reuse.  Node memory is never returned to */
+/* malloc while threads run, so optimistic readers stay safe.       */
+void Retire_node(struct list_node_s* node) {
+   node->next = free_nodes;
+   free_nodes = node;
+}  /* Retire_node */
+
+/*-----------------------------------------------------------------*/
+int Compare_ints(const void* a, const void* b) {
+   int x = *(const int*) a, y = *(const int*) b;
+   return (x > y) - (x < y);
+}  /* Compare_ints */
+
+/*-----------------------------------------------------------------*/
+/* Sort keys and drop repeated values, return how many are left */
+int Sort_unique(int keys[], int count) {
+   int i, n = 0;
+
+   qsort(keys, count, sizeof(int), Compare_ints);
+   for (i = 0; i < count; i++)
+      if (n == 0 || keys[i] != keys[n-1])
+         keys[n++] = keys[i];
+   return n;
+}  /* Sort_unique */
+
+/*-----------------------------------------------------------------*/
+/* Build the (empty) list from keys: sort them and link the nodes */
+/* in one pass instead of count separate Inserts.  Returns the    */
+/* number of nodes created                                        */
+int Bulk_load(int keys[], int count) {
+   struct list_node_s** tail = &head;
+   struct list_node_s* temp;
+   int i;
+
+   count = Sort_unique(keys, count);
+   for (i = 0; i < count; i++) {
+      temp = Alloc_node();
+      temp->data = keys[i];
+      *tail = temp;
+      tail = &temp->next;
+   }
+   *tail = NULL;
+   return count;
+}  /* Bulk_load */
+
+/*-----------------------------------------------------------------*/
+int Compare_batch_ops(const void* a, const void* b) {
+   const batch_op* x = a;
+   const batch_op* y = b;
+
+   if (x->value != y->value)
+      return (x->value > y->value) - (x->value < y->value);
+   return x->seq - y->seq;
+}  /* Compare_batch_ops */
+
+/*-----------------------------------------------------------------*/
+/* Apply a group of ops in one traversal.  Ops are sorted by key   */
+/* (equal keys keep submission order) and each one continues from */
+/* where the previous stopped.  Results are left in ops[].result   */
+void Apply_batch(batch_op ops[], int count) {
+   struct list_node_s* curr = head;
+   struct list_node_s* pred = NULL;
+   struct list_node_s* temp;
+   int k, value;
+
+   qsort(ops, count, sizeof(batch_op), Compare_batch_ops);
+   for (k = 0; k < count; k++) {
+      value = ops[k].value;
+      while (curr != NULL && curr->data < value) {
+         pred = curr;
+         curr = curr->next;
+      }
+      if (ops[k].type == OP_MEMBER) {
+         ops[k].result = (curr != NULL && curr->data == value);
+      } else if (ops[k].type == OP_INSERT) {
+         if (curr == NULL || curr->data > value) {
+            temp = Alloc_node();
+            temp->data = value;
+            temp->next = curr;
+            if (pred == NULL)
+               head = temp;
+            else
+               pred->next = temp;
+            curr = temp;
+            ops[k].result = 1;
+         } else {
+            ops[k].result = 0;
+         }
+      } else { /* delete */
+         if (curr != NULL && curr->data == value) {
+            temp = curr->next;
+            if (pred == NULL)
+               head = temp;
+            else
+               pred->next = temp;
+            Retire_node(curr);
+            curr = temp;
+            ops[k].result = 1;
+         } else {
+            ops[k].result = 0;
+         }
+      }
+   }
+}  /* Apply_batch */
+
+/*-----------------------------------------------------------------*/
+/* Publish an insert or delete and wait until some combiner -- this */
+/* thread, if it can take fc_lock -- has applied it                */
+int Fc_submit(long my_rank, Op_type type, int value) {
+   fc_slot* slot = &fc_slots[my_rank];
+   int unlocked;
+
+   slot->value = value;
+   slot->type = type;
+   atomic_store_explicit(&slot->pending, 1, memory_order_release);
+
+   for (;;) {
+      unlocked = 0;
+      if (atomic_load_explicit(&fc_lock, memory_order_relaxed) == 0 &&
+          atomic_compare_exchange_strong(&fc_lock, &unlocked, 1)) {
+         Fc_combine();
+         atomic_store_explicit(&fc_lock, 0, memory_order_release);
+      }
+      if (atomic_load_explicit(&slot->pending, memory_order_acquire) == 0)
+         return slot->result;
+      sched_yield();
+   }
+}  /* Fc_submit */
+
+/*-----------------------------------------------------------------*/
+/* Apply every published op in one sorted traversal and post the  */
+/* results back.  Caller holds fc_lock                            */
+void Fc_combine(void) {
+   fc_slot* slot;
+   int r, k, n = 0;
+
+   for (r = 0; r < thread_count; r++) {
+      slot = &fc_slots[r];
+      if (atomic_load_explicit(&slot->pending, memory_order_acquire)) {
+         fc_batch[n].value = slot->value;
+         fc_batch[n].type = slot->type;
+         fc_batch[n].seq = r;
+         n++;
+      }
+   }
+
+   write_lock(&rwlock);
+   Apply_batch(fc_batch, n);
+   rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
+
+   for (k = 0; k < n; k++) {
+      slot = &fc_slots[fc_batch[k].seq];
+      slot->result = fc_batch[k].result;
+      atomic_store_explicit(&slot->pending, 0, memory_order_release);
+   }
+   if (atomic_load_explicit(&fc_measuring, memory_order_relaxed)) {
+      fc_passes++;
+      fc_combined += n;
+   }
+}  /* Fc_combine */
+
+/*-----------------------------------------------------------------*/
+/* Writers bracket list changes with these while holding the write */
+/* lock; list_version is odd in between                            */
+void Write_begin(void) {
+   atomic_fetch_add_explicit(&list_version, 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+}  /* Write_begin */
+
+void Write_end(void) {
+   atomic_fetch_add_explicit(&list_version, 1, memory_order_release);
+}  /* Write_end */
+
+/*-----------------------------------------------------------------*/
+/* Lock-free Member: traverse, then check that no writer ran.      */
+/* Falls back to the read lock after OPT_RETRIES failed attempts.  */
+int Member_optimistic(int value, long* retries_p, long* fallbacks_p) {
+   struct list_node_s* temp;
+   unsigned version;
+   int attempt, steps, found;
+
+   for (attempt = 0; attempt < OPT_RETRIES; attempt++) {
+      version = atomic_load_explicit(&list_version, memory_order_acquire);
+      if (version & 1) {
+         (*retries_p)++;
+         continue;
+      }
+      temp = __atomic_load_n(&head, __ATOMIC_RELAXED);
+      steps = 0;
+      while (temp != NULL && __atomic_load_n(&temp->data, __ATOMIC_RELAXED) < value) {
+         temp = __atomic_load_n(&temp->next, __ATOMIC_RELAXED);
+         /* A recycled node may lead anywhere, so stop early once */
+         /* a writer has been seen                                */
+         if (++steps % OPT_CHECK_INTERVAL == 0 &&
+             atomic_load_explicit(&list_version, memory_order_relaxed) != version)
+            break;
+      }
+      found = temp != NULL && __atomic_load_n(&temp->data, __ATOMIC_RELAXED) == value;
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&list_version, memory_order_relaxed) == version)
+         return found;
+      (*retries_p)++;
+   }
+
+   (*fallbacks_p)++;
+   read_lock(&rwlock);
+   found = Member(value);
+   rw_unlock(&rwlock, READ_UNLOCK, PRIORITY_WRITERS);
+   return found;
+}  /* Member_optimistic */
+
 /*-----------------------------------------------------------------*/
 int  Is_empty(void) {
    if (head == NULL)
@@ -337,28 +1205,34 @@ int  Is_empty(void) {
 void* Thread_workA(void* rank) {
    long my_rank = (long) rank;
    int i, val;
-   double which_op;
+   Op_type op;
+   unsigned long t0;
    unsigned seed = my_rank + 1;
    int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
 
-   for (i = 0; i < ops_per_thread; i++) {
-      which_op = my_drand(&seed);
-      val = my_rand(&seed) % MAX_KEY;
-      if (which_op < search_percent) {
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      op = Next_op(&seed, &val);
+      t0 = now_ns();
+      if (op == OP_MEMBER) {
          read_lock(&rwlock);
-         Member(val);
+         Set_member(val);
          rw_unlock(&rwlock, READ_UNLOCK, PRIORITY_READERS);
-      } else if (which_op < search_percent + insert_percent) {
+      } else if (op == OP_INSERT) {
          write_lock(&rwlock);
-         Insert(val);
+         Set_insert(val);
          rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_READERS);
       } else { /* delete */
          write_lock(&rwlock);
-         Delete(val);
+         Set_delete(val);
          rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_READERS);
       }
+      if (i >= 0) latency_record(&lat[op], now_ns() - t0);
    }  /* for */
 
+   Merge_latencies(lat);
    return NULL;
 }  /* Thread_workA */
 
@@ -366,34 +1240,316 @@ void* Thread_workA(void* rank) {
 void* Thread_workB(void* rank) {
    long my_rank = (long) rank;
    int i, val;
-   double which_op;
+   Op_type op;
+   unsigned long t0;
    unsigned seed = my_rank + 1;
    int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
 
-   for (i = 0; i < ops_per_thread; i++) {
-      which_op = my_drand(&seed);
-      val = my_rand(&seed) % MAX_KEY;
-      if (which_op < search_percent) {
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      op = Next_op(&seed, &val);
+      t0 = now_ns();
+      if (op == OP_MEMBER) {
          read_lock(&rwlock);
-         Member(val);
+         Set_member(val);
          rw_unlock(&rwlock, READ_UNLOCK, PRIORITY_WRITERS);
-      } else if (which_op < search_percent + insert_percent) {
+      } else if (op == OP_INSERT) {
          write_lock(&rwlock);
+         Set_insert(val);
+         rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
+      } else { /* delete */
+         write_lock(&rwlock);
+         Set_delete(val);
+         rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
+      }
+      if (i >= 0) latency_record(&lat[op], now_ns() - t0);
+   }   /* for */
+
+   Merge_latencies(lat);
+   return NULL;
+}  /* Thread_workB */
+
+/*-----------------------------------------------------------------*/
+void* Thread_workC(void* rank) {
+   long my_rank = (long) rank;
+   int i, val;
+   Op_type op;
+   unsigned long t0;
+   unsigned seed = my_rank + 1;
+   int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
+   long my_lookups = 0, my_retries = 0, my_fallbacks = 0;
+
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) {
+         Start_measurement();
+         my_lookups = my_retries = my_fallbacks = 0;
+      }
+      op = Next_op(&seed, &val);
+      t0 = now_ns();
+      if (op == OP_MEMBER) {
+         Member_optimistic(val, &my_retries, &my_fallbacks);
+         my_lookups++;
+      } else if (op == OP_INSERT) {
+         write_lock(&rwlock);
+         Write_begin();
          Insert(val);
+         Write_end();
          rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
       } else { /* delete */
          write_lock(&rwlock);
+         Write_begin();
          Delete(val);
+         Write_end();
          rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
       }
+      if (i >= 0) latency_record(&lat[op], now_ns() - t0);
    }   /* for */
 
+   Merge_latencies(lat);
+   pthread_mutex_lock(&count_mutex);
+   optimistic_lookups += my_lookups;
+   optimistic_retries += my_retries;
+   optimistic_fallbacks += my_fallbacks;
+   pthread_mutex_unlock(&count_mutex);
+
    return NULL;
-}  /* Thread_workB */
+}  /* Thread_workC */
+
+/*-----------------------------------------------------------------*/
+/* The set does its own locking, so no rw_lock here */
+void* Thread_workD(void* rank) {
+   long my_rank = (long) rank;
+   int i, val;
+   Op_type op;
+   unsigned long t0;
+   unsigned seed = my_rank + 1;
+   int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
+
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      op = Next_op(&seed, &val);
+      t0 = now_ns();
+      if (op == OP_MEMBER) {
+         Set_member(val);
+      } else if (op == OP_INSERT) {
+         Set_insert(val);
+      } else { /* delete */
+         Set_delete(val);
+      }
+      if (i >= 0) latency_record(&lat[op], now_ns() - t0);
+   }   /* for */
+
+   Merge_latencies(lat);
+   return NULL;
+}  /* Thread_workD */
+
+/*-----------------------------------------------------------------*/
+/* Collect batch_size ops, then apply them under one lock: the read */
+/* lock if the batch is all lookups, the write lock otherwise.      */
+/* Every op of a batch is charged the time from its submission to   */
+/* the end of the batch.                                            */
+void* Thread_workE(void* rank) {
+   long my_rank = (long) rank;
+   int i, k, n = 0, writes = 0;
+   double start, finish;
+   unsigned long t1;
+   unsigned long* submitted = malloc(batch_size*sizeof(unsigned long));
+   unsigned seed = my_rank + 1;
+   int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
+   batch_op* batch = malloc(batch_size*sizeof(batch_op));
+   double my_latency = 0.0;
+   long my_batches = 0;
+
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      batch[n].type = Next_op(&seed, &batch[n].value);
+      batch[n].seq = n;
+      submitted[n] = now_ns();
+      if (batch[n].type != OP_MEMBER) writes = 1;
+      n++;
+
+      /* A batch never spans the end of the warm-up */
+      if (n == batch_size || i == ops_per_thread - 1 || i == -1) {
+         GET_TIME(start);
+         if (writes) {
+            write_lock(&rwlock);
+            Apply_batch(batch, n);
+            rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
+         } else {
+            read_lock(&rwlock);
+            Apply_batch(batch, n);
+            rw_unlock(&rwlock, READ_UNLOCK, PRIORITY_WRITERS);
+         }
+         GET_TIME(finish);
+         if (i >= 0) {
+            t1 = now_ns();
+            for (k = 0; k < n; k++)
+               latency_record(&lat[batch[k].type], t1 - submitted[batch[k].seq]);
+            my_latency += finish - start;
+            my_batches++;
+         }
+         n = writes = 0;
+      }
+   }   /* for */
+
+   Merge_latencies(lat);
+   pthread_mutex_lock(&count_mutex);
+   batch_latency_sum += my_latency;
+   batch_count += my_batches;
+   pthread_mutex_unlock(&count_mutex);
+
+   free(batch);
+   free(submitted);
+   return NULL;
+}  /* Thread_workE */
+
+/*-----------------------------------------------------------------*/
+void* Thread_workF(void* rank) {
+   long my_rank = (long) rank;
+   int i, val;
+   Op_type op;
+   unsigned long t0;
+   unsigned seed = my_rank + 1;
+   int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
+
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      op = Next_op(&seed, &val);
+      t0 = now_ns();
+      if (op == OP_MEMBER) {
+         read_lock(&rwlock);
+         Member(val);
+         rw_unlock(&rwlock, READ_UNLOCK, PRIORITY_WRITERS);
+      } else {
+         Fc_submit(my_rank, op, val);
+      }
+      if (i >= 0) latency_record(&lat[op], now_ns() - t0);
+   }   /* for */
+
+   Merge_latencies(lat);
+   return NULL;
+}  /* Thread_workF */
+
+/*-----------------------------------------------------------------*/
+void* Thread_workG(void* rank) {
+   long my_rank = (long) rank;
+   int i, val;
+   Op_type op;
+   unsigned long t0;
+   unsigned seed = my_rank + 1;
+   int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
+
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      op = Next_op(&seed, &val);
+      t0 = now_ns();
+      if (op == OP_MEMBER) {
+         pf_read_lock(&pflock);
+         Set_member(val);
+         pf_rw_unlock(&pflock, READ_UNLOCK);
+      } else if (op == OP_INSERT) {
+         pf_write_lock(&pflock);
+         Set_insert(val);
+         pf_rw_unlock(&pflock, WRITE_UNLOCK);
+      } else { /* delete */
+         pf_write_lock(&pflock);
+         Set_delete(val);
+         pf_rw_unlock(&pflock, WRITE_UNLOCK);
+      }
+      if (i >= 0) latency_record(&lat[op], now_ns() - t0);
+   }   /* for */
+
+   Merge_latencies(lat);
+   return NULL;
+}  /* Thread_workG */
+
+/*-----------------------------------------------------------------*/
+/* Lookups are queued until a write, INTERLEAVE_GROUP lookups or   */
+/* the end of the warm-up/measured phase, then answered together   */
+/* under one read lock; writes take the write lock as usual.  Each */
+/* lookup is charged the time from its submission to the end of    */
+/* its group.                                                      */
+void* Thread_workH(void* rank) {
+   long my_rank = (long) rank;
+   int i, k, n = 0, val;
+   Op_type op;
+   double start, finish;
+   unsigned long t0, t1;
+   unsigned long submitted[INTERLEAVE_GROUP];
+   int values[INTERLEAVE_GROUP], results[INTERLEAVE_GROUP];
+   unsigned seed = my_rank + 1;
+   int ops_per_thread = total_ops/thread_count;
+   int warmup_per_thread = warmup_ops/thread_count;
+   latency_hist* lat = Alloc_latencies();
+   long my_lookups = 0;
+   double my_time = 0.0;
+
+   for (i = -warmup_per_thread; i < ops_per_thread; i++) {
+      if (i == 0) Start_measurement();
+      op = Next_op(&seed, &val);
+      if (op == OP_MEMBER) {
+         values[n] = val;
+         submitted[n++] = now_ns();
+      }
+
+      if (n > 0 && (op != OP_MEMBER || n == INTERLEAVE_GROUP ||
+                    i == ops_per_thread - 1 || i == -1)) {
+         GET_TIME(start);
+         read_lock(&rwlock);
+         Set_member_batch(values, results, n, batch_size);
+         rw_unlock(&rwlock, READ_UNLOCK, PRIORITY_WRITERS);
+         GET_TIME(finish);
+         /* Warm-up lookups are flushed at i == -1 */
+         if (i >= 0) {
+            t1 = now_ns();
+            for (k = 0; k < n; k++)
+               latency_record(&lat[OP_MEMBER], t1 - submitted[k]);
+            my_time += finish - start;
+            my_lookups += n;
+         }
+         n = 0;
+      }
+
+      /* A write is timed from here, not including the lookups */
+      /* flushed ahead of it                                      */
+      if (op == OP_INSERT) {
+         t0 = now_ns();
+         write_lock(&rwlock);
+         Set_insert(val);
+         rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
+      } else if (op == OP_DELETE) {
+         t0 = now_ns();
+         write_lock(&rwlock);
+         Set_delete(val);
+         rw_unlock(&rwlock, WRITE_UNLOCK, PRIORITY_WRITERS);
+      }
+      if (i >= 0 && op != OP_MEMBER) latency_record(&lat[op], now_ns() - t0);
+   }   /* for */
+
+   Merge_latencies(lat);
+   pthread_mutex_lock(&count_mutex);
+   interleave_lookups += my_lookups;
+   interleave_time += my_time;
+   pthread_mutex_unlock(&count_mutex);
+
+   return NULL;
+}  /* Thread_workH */
 
 /*-----------------------------------------------------------------*/
 
 void  output_csv(FILE *fp, const char* label, double elapsed_time) {
-    fprintf(fp, "%s,%d,%lf,%lf,%lf,%e\n", label, thread_count, search_percent,
+    fprintf(fp, "%s%s%s,%d,%lf,%lf,%lf,%e\n", label, structure_suffix, dist_suffix, thread_count, search_percent,
                                           insert_percent, delete_percent, elapsed_time);
 } /* output_csv*/
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include "hash_set.h"
+
+/* Lock-striped chained hash set with incremental resizing.
+ *
+ * Every operation runs under the lock of its key's stripe.  Table sizes
+ * are powers of two and multiples of HS_STRIPES, so a bucket and the two
+ * buckets it splits into on a resize all belong to the same stripe.
+ *
+ * Growing does not stop the world: the thread that sees its stripe over
+ * the load limit publishes a table of twice the size in next_table, and
+ * from then on every operation also moves HS_MIGRATE_CHUNK old buckets
+ * (each under its stripe lock), leaving MOVED behind.  The operation that
+ * moves the last bucket makes the new table current.  Drained bucket
+ * arrays are only freed by destroy_hash_set, so a thread holding a stale
+ * table pointer never reads freed memory. */
+
+static hs_node moved_marker;
+#define MOVED (&moved_marker)
+
+static inline unsigned hash(int key) {
+    unsigned h = (unsigned) key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static hs_table* new_table(size_t size, hs_table* src) {
+    hs_table* t = malloc(sizeof(hs_table));
+    t->size = size;
+    t->buckets = calloc(size, sizeof(hs_node*));
+    t->src = src;
+    atomic_init(&t->cursor, 0);
+    atomic_init(&t->migrated, 0);
+    t->retired_next = NULL;
+    return t;
+}
+
+static void free_chain(hs_node* node) {
+    hs_node* following;
+
+    while (node != NULL && node != MOVED) {
+        following = node->next;
+        free(node);
+        node = following;
+    }
+}
+
+/* Chain head for h.  Caller holds the stripe lock of h. */
+static hs_node** bucket_of(hash_set* set, unsigned h) {
+    hs_table* next = atomic_load(&set->next_table);
+    hs_table* t = atomic_load(&set->table);
+    hs_node** bucket = &t->buckets[h & (t->size - 1)];
+
+    if (next != NULL && *bucket == MOVED)
+        bucket = &next->buckets[h & (next->size - 1)];
+    return bucket;
+}
+
+/* Move old buckets [first, last) of next->src into next */
+static void migrate_range(hash_set* set, hs_table* next, size_t first, size_t last) {
+    hs_table* src = next->src;
+    hs_stripe* stripe;
+    hs_node* node;
+    hs_node* following;
+    hs_node** dest;
+    size_t b;
+
+    for (b = first; b < last; b++) {
+        stripe = &set->stripes[b & (HS_STRIPES - 1)];
+        pthread_mutex_lock(&stripe->lock);
+        node = src->buckets[b];
+        while (node != NULL) {
+            following = node->next;
+            dest = &next->buckets[hash(node->key) & (next->size - 1)];
+            node->next = *dest;
+            *dest = node;
+            node = following;
+        }
+        src->buckets[b] = MOVED;
+        pthread_mutex_unlock(&stripe->lock);
+    }
+}
+
+/* Called without any stripe lock held */
+static void help_resize(hash_set* set) {
+    hs_table* next = atomic_load(&set->next_table);
+    size_t first, last, old_size;
+
+    if (next == NULL) return;
+    old_size = next->src->size;
+    first = atomic_fetch_add(&next->cursor, HS_MIGRATE_CHUNK);
+    if (first >= old_size) return;
+    last = first + HS_MIGRATE_CHUNK < old_size ? first + HS_MIGRATE_CHUNK : old_size;
+    migrate_range(set, next, first, last);
+
+    if (atomic_fetch_add(&next->migrated, last - first) + (last - first) == old_size) {
+        pthread_mutex_lock(&set->resize_mutex);
+        next->src->retired_next = set->retired;
+        set->retired = next->src;
+        atomic_store(&set->table, next);
+        atomic_store(&set->next_table, NULL);
+        pthread_mutex_unlock(&set->resize_mutex);
+    }
+}
+
+static void start_resize(hash_set* set, hs_table* full) {
+    pthread_mutex_lock(&set->resize_mutex);
+    if (atomic_load(&set->next_table) == NULL && atomic_load(&set->table) == full)
+        atomic_store(&set->next_table, new_table(2 * full->size, full));
+    pthread_mutex_unlock(&set->resize_mutex);
+}
+
+void init_hash_set(hash_set* set) {
+    int i;
+
+    for (i = 0; i < HS_STRIPES; i++) {
+        pthread_mutex_init(&set->stripes[i].lock, NULL);
+        set->stripes[i].count = 0;
+    }
+    atomic_init(&set->table, new_table(HS_INITIAL_SIZE, NULL));
+    atomic_init(&set->next_table, NULL);
+    pthread_mutex_init(&set->resize_mutex, NULL);
+    set->retired = NULL;
+}
+
+void destroy_hash_set(hash_set* set) {
+    hs_table* tables[2] = { atomic_load(&set->table), atomic_load(&set->next_table) };
+    hs_table* t;
+    size_t b;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (tables[i] == NULL) continue;
+        for (b = 0; b < tables[i]->size; b++)
+            free_chain(tables[i]->buckets[b]);
+        free(tables[i]->buckets);
+        free(tables[i]);
+    }
+    while (set->retired != NULL) {
+        t = set->retired;
+        set->retired = t->retired_next;
+        free(t->buckets);
+        free(t);
+    }
+    for (i = 0; i < HS_STRIPES; i++)
+        pthread_mutex_destroy(&set->stripes[i].lock);
+    pthread_mutex_destroy(&set->resize_mutex);
+}
+
+int hash_member(hash_set* set, int value) {
+    unsigned h = hash(value);
+    hs_stripe* stripe = &set->stripes[h & (HS_STRIPES - 1)];
+    hs_node* node;
+    int rv = 0;
+
+    pthread_mutex_lock(&stripe->lock);
+    for (node = *bucket_of(set, h); node != NULL; node = node->next) {
+        if (node->key == value) {
+            rv = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    help_resize(set);
+    return rv;
+}
+
+int hash_insert(hash_set* set, int value) {
+    unsigned h = hash(value);
+    hs_stripe* stripe = &set->stripes[h & (HS_STRIPES - 1)];
+    hs_table* t = atomic_load(&set->table);
+    hs_node** bucket;
+    hs_node* node;
+    int grow = 0;
+
+    pthread_mutex_lock(&stripe->lock);
+    bucket = bucket_of(set, h);
+    for (node = *bucket; node != NULL; node = node->next) {
+        if (node->key == value) {
+            pthread_mutex_unlock(&stripe->lock);
+            help_resize(set);
+            return 0;
+        }
+    }
+    node = malloc(sizeof(hs_node));
+    node->key = value;
+    node->next = *bucket;
+    *bucket = node;
+    stripe->count++;
+    if (stripe->count > (long) (HS_MAX_LOAD * (t->size / HS_STRIPES)))
+        grow = 1;
+    pthread_mutex_unlock(&stripe->lock);
+
+    if (grow) start_resize(set, t);
+    help_resize(set);
+    return 1;
+}
+
+int hash_delete(hash_set* set, int value) {
+    unsigned h = hash(value);
+    hs_stripe* stripe = &set->stripes[h & (HS_STRIPES - 1)];
+    hs_node** link;
+    hs_node* node;
+    int rv = 0;
+
+    pthread_mutex_lock(&stripe->lock);
+    for (link = bucket_of(set, h); *link != NULL; link = &(*link)->next) {
+        if ((*link)->key == value) {
+            node = *link;
+            *link = node->next;
+            free(node);
+            stripe->count--;
+            rv = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    help_resize(set);
+    return rv;
+}
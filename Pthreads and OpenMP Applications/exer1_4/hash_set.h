@@ -0,0 +1,50 @@
+#ifndef HASH_SET_H
+#define HASH_SET_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define HS_STRIPES       64     /* lock stripes, a power of two */
+#define HS_INITIAL_SIZE  1024   /* buckets, a multiple of HS_STRIPES */
+#define HS_MAX_LOAD      2      /* average chain length that triggers a resize */
+#define HS_MIGRATE_CHUNK 16     /* old buckets moved per helping op */
+
+typedef struct hs_node {
+    int key;
+    struct hs_node* next;
+} hs_node;
+
+/* Bucket array.  While a resize is in progress the new table points
+ * back at the table being drained into it. */
+typedef struct hs_table {
+    size_t size;
+    hs_node** buckets;
+    struct hs_table* src;
+    atomic_size_t cursor;
+    atomic_size_t migrated;
+    struct hs_table* retired_next;
+} hs_table;
+
+/* One lock per stripe; the stripe of a key is its hash modulo
+ * HS_STRIPES, which is the same in every table size. */
+typedef struct {
+    pthread_mutex_t lock;
+    long count;
+} __attribute__((aligned(64))) hs_stripe;
+
+typedef struct {
+    hs_stripe stripes[HS_STRIPES];
+    _Atomic(hs_table*) table;
+    _Atomic(hs_table*) next_table;
+    pthread_mutex_t resize_mutex;
+    hs_table* retired;
+} hash_set;
+
+void init_hash_set(hash_set* set);
+void destroy_hash_set(hash_set* set);
+int  hash_insert(hash_set* set, int value);
+int  hash_member(hash_set* set, int value);
+int  hash_delete(hash_set* set, int value);
+
+#endif // HASH_SET_H
@@ -0,0 +1,38 @@
+#include <string.h>
+#include "latency_hist.h"
+
+/* Largest value that falls in bucket b */
+static unsigned long bucket_limit(int b) {
+    int shift;
+
+    if (b < LH_SUB_BUCKETS) return b;
+    shift = b / LH_SUB_BUCKETS - 1;
+    return ((unsigned long) (b % LH_SUB_BUCKETS + LH_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+void init_latency_hist(latency_hist* h) {
+    memset(h, 0, sizeof(latency_hist));
+}
+
+void latency_merge(latency_hist* dst, const latency_hist* src) {
+    int b;
+
+    for (b = 0; b < LH_BUCKETS; b++)
+        dst->counts[b] += src->counts[b];
+    dst->count += src->count;
+}
+
+/* Smallest bucket limit that covers a fraction p of the samples */
+unsigned long latency_percentile(const latency_hist* h, double p) {
+    long target = (long) (p * h->count);
+    long seen = 0;
+    int b;
+
+    if (h->count == 0) return 0;
+    if (target < p * h->count || target < 1) target++;
+    for (b = 0; b < LH_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= target) return bucket_limit(b);
+    }
+    return bucket_limit(LH_BUCKETS - 1);
+}
@@ -0,0 +1,44 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <time.h>
+
+/* Log-linear (HDR style) latency histogram in nanoseconds.  Values
+ * below LH_SUB_BUCKETS are exact; above that every power of two is
+ * split into LH_SUB_BUCKETS buckets, so the relative error stays below
+ * 1/LH_SUB_BUCKETS.  Recording is one increment in a thread-private
+ * histogram; histograms are merged after the threads finish. */
+#define LH_SUB_BITS    5
+#define LH_SUB_BUCKETS (1 << LH_SUB_BITS)
+#define LH_BUCKETS     ((65 - LH_SUB_BITS) * LH_SUB_BUCKETS)
+
+typedef struct {
+    long count;
+    long counts[LH_BUCKETS];
+} latency_hist;
+
+static inline unsigned long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+static inline int latency_bucket(unsigned long ns) {
+    int msb;
+
+    if (ns < LH_SUB_BUCKETS) return (int) ns;
+    msb = 63 - __builtin_clzl(ns);
+    return (msb - LH_SUB_BITS + 1) * LH_SUB_BUCKETS +
+           (int) ((ns >> (msb - LH_SUB_BITS)) - LH_SUB_BUCKETS);
+}
+
+static inline void latency_record(latency_hist* h, unsigned long ns) {
+    h->counts[latency_bucket(ns)]++;
+    h->count++;
+}
+
+void init_latency_hist(latency_hist* h);
+void latency_merge(latency_hist* dst, const latency_hist* src);
+unsigned long latency_percentile(const latency_hist* h, double p);
+
+#endif // LATENCY_HIST_H
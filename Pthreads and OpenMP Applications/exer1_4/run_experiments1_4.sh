@@ -4,7 +4,18 @@
 thread_values=(1 2 4)
 search_percentages=(0.9 0.95 0.999)
 insert_percentages=(0.05 0.025 0.0005)
-approaches=(0 1 2)
+approaches=(0 1 2 3 4 5 6 7 8)
+# Batch sizes tried by approach 5
+batch_sizes=(1 4 16 64 256)
+# Lookups in flight for approach 8
+interleave_widths=(1 2 4 8 16 32 64)
+# rw_lock implementations: condition variables and futex
+binaries=(exercise1_4 exercise1_4_futex)
+# Set structures: classic list, unrolled list, hash set, sorted array and B+tree
+structures=(0 1 2 3 4)
+# Key distributions of the measured ops, with a warm-up before timing
+distributions=(uniform zipf hotset)
+warmup_ops=50000
 
 # Specify the number of times to run the program for each input and thread count
 num_runs=5
@@ -14,7 +25,7 @@ for thread_count in "${thread_values[@]}"; do
     for approach in "${approaches[@]}"; do
         # Skip combinations where approach is Serial and thread_count is not 1,
         # approach is parallel and thread_count is equal to 1
-        if ( [ "$approach" -eq 0 ] && [ "$thread_count" -ne 1 ] ) || ( [ "$approach" -eq 1 ] && [ "$thread_count" -eq 1 ] ) || ( [ "$approach" -eq 2 ] && [ "$thread_count" -eq 1 ] ); then
+        if ( [ "$approach" -eq 0 ] && [ "$thread_count" -ne 1 ] ) || ( [ "$approach" -ne 0 ] && [ "$thread_count" -eq 1 ] ); then
             continue
         fi 
         # Loop through pairs of search and insert percentages
@@ -22,8 +33,34 @@ for thread_count in "${thread_values[@]}"; do
             search_percentage=${search_percentages[$pair_index]}
             insert_percentage=${insert_percentages[$pair_index]}
             # Run the program multiple times for the current inputs
-            for ((i = 1; i <= num_runs; i++)); do
-                ./exercise1_4 $thread_count $search_percentage $insert_percentage $approach
+            for binary in "${binaries[@]}"; do
+                # The serial and lock-free approaches take no rw_lock and the
+                # phase-fair lock is the same in both binaries, run them only once
+                if ( [ "$approach" -eq 0 ] || [ "$approach" -eq 4 ] || [ "$approach" -eq 7 ] ) && [ "$binary" != "exercise1_4" ]; then
+                    continue
+                fi
+                for structure in "${structures[@]}"; do
+                    # Optimistic lookups, batches and flat combining only exist
+                    # for the classic list, lock-free driving only for the structures
+                    # that synchronise internally, interleaved lookups only for the lists
+                    if ( [ "$approach" -ge 3 ] && [ "$approach" -le 6 ] && [ "$approach" -ne 4 ] && [ "$structure" -ne 0 ] ) || ( [ "$approach" -eq 4 ] && [ "$structure" -lt 2 ] ) || ( [ "$approach" -eq 8 ] && [ "$structure" -ge 2 ] ); then
+                        continue
+                    fi
+                    if [ "$approach" -eq 5 ]; then
+                        run_batch_sizes=("${batch_sizes[@]}")
+                    elif [ "$approach" -eq 8 ]; then
+                        run_batch_sizes=("${interleave_widths[@]}")
+                    else
+                        run_batch_sizes=(1)
+                    fi
+                    for batch_size in "${run_batch_sizes[@]}"; do
+                        for distribution in "${distributions[@]}"; do
+                            for ((i = 1; i <= num_runs; i++)); do
+                                ./$binary -d $distribution -w $warmup_ops $thread_count $search_percentage $insert_percentage $approach $structure $batch_size
+                            done
+                        done
+                    done
+                done
             done
         done
     done
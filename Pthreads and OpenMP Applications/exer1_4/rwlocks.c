@@ -1,27 +1,319 @@
 #include <pthread.h>
+#include "rwlocks.h"
 
+#ifdef RWLOCK_PROFILE
+/* Contention profiler, compiled in with -DRWLOCK_PROFILE ("make
+ * PROFILE=1").  Each thread keeps the acquisition it is waiting for or
+ * holding in thread-local storage; rw_unlock charges it to the lock and
+ * to the thread under [type][strategy].  Lock totals are printed by
+ * destroy_rwlock, per-thread totals at exit.  A thread is assumed to
+ * hold at most one rw_lock at a time. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-/* Struct for read-write lock*/
-typedef struct {
-    pthread_mutex_t mutex;
-    pthread_cond_t read_cond;
-    pthread_cond_t write_cond;
-    int active_readers;
-    int waiting_readers;
-    int active_writers;
-    int waiting_writers;
-} rw_lock;
+typedef struct rw_prof_thread {
+    int id;
+    rw_prof_counts counts[2][2];
+    struct rw_prof_thread* next;
+} rw_prof_thread;
 
-typedef enum {
-    READ_UNLOCK,
-    WRITE_UNLOCK
-} UnlockType;
+static __thread rw_prof_thread* prof_self;
+static __thread struct {
+    unsigned long start_ns, acquired_ns;
+    long waits;
+    int contended;
+} prof_pending;
 
-typedef enum {
-    PRIORITY_READERS,
-    PRIORITY_WRITERS
-} UnlockStrategy;
+static rw_prof_thread* prof_threads;
+static rw_prof_thread** prof_tail = &prof_threads;
+static int prof_thread_count;
+static pthread_mutex_t prof_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long prof_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+static void prof_print(const char* who, rw_prof_counts c[2][2]) {
+    const char* types[2] = { "read", "write" };
+    const char* strategies[2] = { "PRIORITY_READERS", "PRIORITY_WRITERS" };
+    int t, st;
+
+    for (t = 0; t < 2; t++)
+        for (st = 0; st < 2; st++) {
+            rw_prof_counts* p = &c[t][st];
+            if (p->acquisitions == 0) continue;
+            printf("%-10s %-5s %-16s acq %ld  contended %ld (%.2f%%)  "
+                   "wait avg %.3f max %.3f us  hold avg %.3f us  "
+                   "wakeups %ld (spurious %ld)  signals %ld\n",
+                   who, types[t], strategies[st], p->acquisitions,
+                   p->contended, 100.0 * p->contended / p->acquisitions,
+                   p->wait_ns / 1000.0 / p->acquisitions, p->max_wait_ns / 1000.0,
+                   p->hold_ns / 1000.0 / p->acquisitions,
+                   p->wakeups, p->spurious, p->signals);
+        }
+}
+
+static void prof_dump_threads(void) {
+    rw_prof_thread* t;
+    char who[32];
+
+    for (t = prof_threads; t != NULL; t = t->next) {
+        snprintf(who, sizeof(who), "thread %d", t->id);
+        prof_print(who, t->counts);
+    }
+}
+
+static rw_prof_thread* prof_thread(void) {
+    if (prof_self == NULL) {
+        prof_self = calloc(1, sizeof(rw_prof_thread));
+        pthread_mutex_lock(&prof_mutex);
+        if (prof_thread_count == 0) atexit(prof_dump_threads);
+        prof_self->id = prof_thread_count++;
+        *prof_tail = prof_self;
+        prof_tail = &prof_self->next;
+        pthread_mutex_unlock(&prof_mutex);
+    }
+    return prof_self;
+}
+
+static void prof_add(rw_prof_counts* c, long contended, long wakeups,
+                     unsigned long wait, unsigned long hold) {
+    unsigned long max = __atomic_load_n(&c->max_wait_ns, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&c->acquisitions, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->contended, contended, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->wakeups, wakeups, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->spurious, wakeups > 0 ? wakeups - 1 : 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->wait_ns, wait, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->hold_ns, hold, __ATOMIC_RELAXED);
+    while (wait > max && !__atomic_compare_exchange_n(&c->max_wait_ns, &max,
+                wait, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void prof_release(rw_lock* lock, UnlockType type, UnlockStrategy strategy) {
+    unsigned long now = prof_now();
+    unsigned long wait = prof_pending.acquired_ns - prof_pending.start_ns;
+    unsigned long hold = now - prof_pending.acquired_ns;
+
+    prof_add(&lock->prof[type][strategy], prof_pending.contended,
+             prof_pending.waits, wait, hold);
+    prof_add(&prof_thread()->counts[type][strategy], prof_pending.contended,
+             prof_pending.waits, wait, hold);
+}
+
+static void prof_signal(rw_lock* lock, UnlockType type, UnlockStrategy strategy) {
+    __atomic_fetch_add(&lock->prof[type][strategy].signals, 1, __ATOMIC_RELAXED);
+    prof_thread()->counts[type][strategy].signals++;
+}
+
+#define PROF_BEGIN()        (prof_pending.start_ns = prof_now(), \
+                             prof_pending.waits = prof_pending.contended = 0)
+#define PROF_CONTENDED()    (prof_pending.contended = 1)
+#define PROF_WAIT()         (prof_pending.waits++)
+#define PROF_ACQUIRED()     (prof_pending.acquired_ns = prof_now())
+#define PROF_RELEASE(lock, type, strategy)  prof_release(lock, type, strategy)
+#define PROF_SIGNAL(lock, type, strategy)   prof_signal(lock, type, strategy)
+#define PROF_INIT(lock)     memset((lock)->prof, 0, sizeof((lock)->prof))
+#define PROF_DUMP(lock)     do { \
+        char who[32]; \
+        snprintf(who, sizeof(who), "lock %p", (void*) (lock)); \
+        prof_print(who, (lock)->prof); \
+    } while (0)
+#else
+#define PROF_BEGIN()        ((void)0)
+#define PROF_CONTENDED()    ((void)0)
+#define PROF_WAIT()         ((void)0)
+#define PROF_ACQUIRED()     ((void)0)
+#define PROF_RELEASE(lock, type, strategy)  ((void)0)
+#define PROF_SIGNAL(lock, type, strategy)   ((void)0)
+#define PROF_INIT(lock)     ((void)(lock))
+#define PROF_DUMP(lock)     ((void)(lock))
+#endif
+
+#ifdef FUTEX_RWLOCK
+/* Futex based read-write lock.
+ *
+ * state holds RW_WRITER while a writer owns the lock, otherwise the
+ * number of active readers.  Acquires first spin on the state word for
+ * an adaptive number of rounds and only then park on a futex gate.
+ * Waking bumps the gate so that a waiter that read the old value can
+ * never sleep through the release; all parked readers are admitted with
+ * one FUTEX_WAKE. */
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define RW_WRITER       0x80000000u
+#define RW_SPIN_MIN     4
+#define RW_SPIN_MAX     128
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static void futex_wait(atomic_uint* addr, unsigned val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static inline int try_read(rw_lock* lock) {
+    unsigned s = atomic_load_explicit(&lock->state, memory_order_relaxed);
+    return !(s & RW_WRITER) &&
+           atomic_compare_exchange_weak_explicit(&lock->state, &s, s + 1,
+                   memory_order_acquire, memory_order_relaxed);
+}
+
+static inline int try_write(rw_lock* lock) {
+    unsigned s = 0;
+    return atomic_load_explicit(&lock->state, memory_order_relaxed) == 0 &&
+           atomic_compare_exchange_weak_explicit(&lock->state, &s, RW_WRITER,
+                   memory_order_acquire, memory_order_relaxed);
+}
+
+/* Spin for up to spin_limit rounds; the limit follows a running average
+ * of the rounds that led to success, like glibc's adaptive mutex.
+ * Returns the number of attempts on success, 0 on failure. */
+static int spin_acquire(rw_lock* lock, int (*try_acquire)(rw_lock*)) {
+    int limit = atomic_load_explicit(&lock->spin_limit, memory_order_relaxed);
+    int spins, next;
+
+    for (spins = 0; spins < limit; spins++) {
+        if (try_acquire(lock)) {
+            next = limit + (2*spins + RW_SPIN_MIN - limit) / 8;
+            if (next > RW_SPIN_MAX) next = RW_SPIN_MAX;
+            atomic_store_explicit(&lock->spin_limit, next, memory_order_relaxed);
+            return spins + 1;
+        }
+        cpu_relax();
+    }
+    if (limit > RW_SPIN_MIN)
+        atomic_store_explicit(&lock->spin_limit, limit - limit / 8,
+                memory_order_relaxed);
+    return 0;
+}
+
+static void wake_readers(rw_lock* lock) {
+    atomic_fetch_add(&lock->read_gate, 1);
+    futex_wake(&lock->read_gate, INT_MAX);
+}
+
+static void wake_writer(rw_lock* lock) {
+    atomic_fetch_add(&lock->write_gate, 1);
+    futex_wake(&lock->write_gate, 1);
+}
 
+void init_rwlock(rw_lock* lock) {
+    atomic_init(&lock->state, 0);
+    atomic_init(&lock->read_gate, 0);
+    atomic_init(&lock->write_gate, 0);
+    atomic_init(&lock->waiting_readers, 0);
+    atomic_init(&lock->waiting_writers, 0);
+    atomic_init(&lock->spin_limit, RW_SPIN_MAX / 2);
+    PROF_INIT(lock);
+}
+
+void destroy_rwlock(rw_lock* lock) {
+    PROF_DUMP(lock);
+}
+
+void read_lock(rw_lock* lock) {
+    unsigned seq;
+    int attempts;
+
+    PROF_BEGIN();
+    if ((attempts = spin_acquire(lock, try_read))) {
+        if (attempts > 1) PROF_CONTENDED();
+        PROF_ACQUIRED();
+        return;
+    }
+
+    PROF_CONTENDED();
+    atomic_fetch_add(&lock->waiting_readers, 1);
+    for (;;) {
+        seq = atomic_load(&lock->read_gate);
+        if (!(atomic_load(&lock->state) & RW_WRITER)) {
+            if (try_read(lock)) break;
+            continue;
+        }
+        PROF_WAIT();
+        futex_wait(&lock->read_gate, seq);
+    }
+    atomic_fetch_sub(&lock->waiting_readers, 1);
+    PROF_ACQUIRED();
+}
+
+void write_lock(rw_lock* lock) {
+    unsigned seq;
+    int attempts;
+
+    PROF_BEGIN();
+    if ((attempts = spin_acquire(lock, try_write))) {
+        if (attempts > 1) PROF_CONTENDED();
+        PROF_ACQUIRED();
+        return;
+    }
+
+    PROF_CONTENDED();
+    atomic_fetch_add(&lock->waiting_writers, 1);
+    for (;;) {
+        seq = atomic_load(&lock->write_gate);
+        if (atomic_load(&lock->state) == 0) {
+            if (try_write(lock)) break;
+            continue;
+        }
+        PROF_WAIT();
+        futex_wait(&lock->write_gate, seq);
+    }
+    atomic_fetch_sub(&lock->waiting_writers, 1);
+    PROF_ACQUIRED();
+}
+
+void rw_unlock(rw_lock* lock, UnlockType type, UnlockStrategy strategy) {
+    PROF_RELEASE(lock, type, strategy);
+    if (type == READ_UNLOCK) {
+        if (atomic_fetch_sub(&lock->state, 1) == 1 &&
+                atomic_load(&lock->waiting_writers) > 0) {
+            PROF_SIGNAL(lock, type, strategy);
+            wake_writer(lock);
+        }
+    } else if (type == WRITE_UNLOCK) {
+        atomic_store(&lock->state, 0);
+        if (strategy == PRIORITY_READERS) {
+            if (atomic_load(&lock->waiting_readers) > 0) {
+                PROF_SIGNAL(lock, type, strategy);
+                wake_readers(lock);
+            } else if (atomic_load(&lock->waiting_writers) > 0) {
+                PROF_SIGNAL(lock, type, strategy);
+                wake_writer(lock);
+            }
+        } else if (strategy == PRIORITY_WRITERS) {
+            if (atomic_load(&lock->waiting_writers) > 0) {
+                PROF_SIGNAL(lock, type, strategy);
+                wake_writer(lock);
+            } else if (atomic_load(&lock->waiting_readers) > 0) {
+                PROF_SIGNAL(lock, type, strategy);
+                wake_readers(lock);
+            }
+        }
+    }
+}
+
+#else
 void init_rwlock(rw_lock* lock) {
     lock->active_readers = 0;
     lock->waiting_readers = 0;
@@ -30,56 +322,72 @@ void init_rwlock(rw_lock* lock) {
     pthread_mutex_init(&lock->mutex, NULL);
     pthread_cond_init(&lock->read_cond, NULL);
     pthread_cond_init(&lock->write_cond, NULL);
+    PROF_INIT(lock);
 }
 
 void destroy_rwlock(rw_lock* lock) {
+    PROF_DUMP(lock);
     pthread_mutex_destroy(&lock->mutex);
     pthread_cond_destroy(&lock->read_cond);
-    pthread_cond_destroy(&lock->read_cond);
+    pthread_cond_destroy(&lock->write_cond);
 }
 
 void read_lock(rw_lock* lock) {
+    PROF_BEGIN();
     pthread_mutex_lock(&lock->mutex);
     while (lock->active_writers > 0) {
+        PROF_CONTENDED();
+        PROF_WAIT();
         lock->waiting_readers++;
         pthread_cond_wait(&lock->read_cond, &lock->mutex);
         lock->waiting_readers--;
     }
     lock->active_readers++;
     pthread_mutex_unlock(&lock->mutex);
+    PROF_ACQUIRED();
 }
 
 void write_lock(rw_lock* lock) {
+    PROF_BEGIN();
     pthread_mutex_lock(&lock->mutex);
     while (lock->active_readers > 0 || lock->active_writers > 0) {
+        PROF_CONTENDED();
+        PROF_WAIT();
         lock->waiting_writers++;
         pthread_cond_wait(&lock->write_cond, &lock->mutex);
         lock->waiting_writers--;
     }
     lock->active_writers++;
     pthread_mutex_unlock(&lock->mutex);
+    PROF_ACQUIRED();
 }
 
 void rw_unlock(rw_lock* lock, UnlockType type, UnlockStrategy strategy) {
+    PROF_RELEASE(lock, type, strategy);
     pthread_mutex_lock(&lock->mutex);
 
     if (type == READ_UNLOCK) {
         lock->active_readers--;
         if (lock->active_readers == 0 && lock->waiting_writers > 0) {
+            PROF_SIGNAL(lock, type, strategy);
             pthread_cond_signal(&lock->write_cond);
         }
     } else if (type == WRITE_UNLOCK) {
         lock->active_writers--;
         if (strategy == PRIORITY_READERS) {
             if (lock->waiting_readers > 0) {
+                PROF_SIGNAL(lock, type, strategy);
                 pthread_cond_broadcast(&lock->read_cond);
             } else if (lock->waiting_writers > 0) {
+                PROF_SIGNAL(lock, type, strategy);
                 pthread_cond_signal(&lock->write_cond);
             }
         } else if (strategy == PRIORITY_WRITERS) {
             if (lock->waiting_writers > 0) {
+                PROF_SIGNAL(lock, type, strategy);
                 pthread_cond_signal(&lock->write_cond);
             } else if (lock->waiting_readers > 0) {
+                PROF_SIGNAL(lock, type, strategy);
                 pthread_cond_broadcast(&lock->read_cond);
             }
         }
@@ -87,3 +395,79 @@ void rw_unlock(rw_lock* lock, UnlockType type, UnlockStrategy strategy) {
 
     pthread_mutex_unlock(&lock->mutex);
 }
+#endif
+
+/* Phase-fair lock, the same in both builds.  A reader that finds a
+ * writer active or queued waits for the next reader phase; the writer
+ * that ends its phase admits every waiting reader at once (counting
+ * them as active before they run, so that the next writer cannot slip
+ * in) and the last reader of a phase hands over to the next writer. */
+void init_pf_rwlock(pf_rwlock* lock) {
+    lock->active_readers = 0;
+    lock->waiting_readers = 0;
+    lock->active_writers = 0;
+    lock->read_phase = 0;
+    lock->write_ticket = 0;
+    lock->write_serving = 0;
+    pthread_mutex_init(&lock->mutex, NULL);
+    pthread_cond_init(&lock->read_cond, NULL);
+    pthread_cond_init(&lock->write_cond, NULL);
+}
+
+void destroy_pf_rwlock(pf_rwlock* lock) {
+    pthread_mutex_destroy(&lock->mutex);
+    pthread_cond_destroy(&lock->read_cond);
+    pthread_cond_destroy(&lock->write_cond);
+}
+
+void pf_read_lock(pf_rwlock* lock) {
+    unsigned phase;
+
+    pthread_mutex_lock(&lock->mutex);
+    if (lock->active_writers > 0 || lock->write_ticket != lock->write_serving) {
+        phase = lock->read_phase;
+        lock->waiting_readers++;
+        while (lock->read_phase == phase)
+            pthread_cond_wait(&lock->read_cond, &lock->mutex);
+        /* Counted as active by the writer that started the phase */
+    } else {
+        lock->active_readers++;
+    }
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void pf_write_lock(pf_rwlock* lock) {
+    unsigned ticket;
+
+    pthread_mutex_lock(&lock->mutex);
+    ticket = lock->write_ticket++;
+    while (ticket != lock->write_serving || lock->active_writers > 0 ||
+           lock->active_readers > 0)
+        pthread_cond_wait(&lock->write_cond, &lock->mutex);
+    lock->active_writers++;
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void pf_rw_unlock(pf_rwlock* lock, UnlockType type) {
+    pthread_mutex_lock(&lock->mutex);
+
+    if (type == READ_UNLOCK) {
+        lock->active_readers--;
+        if (lock->active_readers == 0 && lock->write_ticket != lock->write_serving) {
+            pthread_cond_broadcast(&lock->write_cond);
+        }
+    } else if (type == WRITE_UNLOCK) {
+        lock->active_writers--;
+        lock->write_serving++;
+        if (lock->waiting_readers > 0) {
+            lock->active_readers += lock->waiting_readers;
+            lock->waiting_readers = 0;
+            lock->read_phase++;
+            pthread_cond_broadcast(&lock->read_cond);
+        } else if (lock->write_ticket != lock->write_serving) {
+            pthread_cond_broadcast(&lock->write_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&lock->mutex);
+}
@@ -3,6 +3,38 @@
 
 #include <pthread.h>
 
+#ifdef RWLOCK_PROFILE
+/* Contention counters for one (mode, strategy) pair.  The strategy of
+ * an acquisition is the one passed to the rw_unlock that ends it. */
+typedef struct {
+    long acquisitions;
+    long contended;         /* first attempt failed */
+    long wakeups;           /* returns from a cond/futex wait */
+    long spurious;          /* wakeups that had to wait again */
+    long signals;           /* signals/broadcasts issued on unlock */
+    unsigned long wait_ns, max_wait_ns, hold_ns;
+} rw_prof_counts;
+
+#define RW_PROF_FIELDS  rw_prof_counts prof[2][2];  /* [UnlockType][UnlockStrategy] */
+#else
+#define RW_PROF_FIELDS
+#endif
+
+#ifdef FUTEX_RWLOCK
+#include <stdatomic.h>
+
+/* Futex read-write lock: one state word (writer bit + reader count),
+ * plus two futex words that waiting readers/writers park on. */
+typedef struct {
+    atomic_uint state;
+    atomic_uint read_gate;
+    atomic_uint write_gate;
+    atomic_uint waiting_readers;
+    atomic_uint waiting_writers;
+    atomic_int spin_limit;
+    RW_PROF_FIELDS
+} rw_lock;
+#else
 typedef struct {
     pthread_mutex_t mutex;
     pthread_cond_t read_cond;
@@ -12,7 +44,9 @@ typedef struct {
     int active_writers;
     int waiting_writers;
     int write_priority;
+    RW_PROF_FIELDS
 } rw_lock;
+#endif
 
 typedef enum {
     READ_UNLOCK,
@@ -30,4 +64,25 @@ void read_lock(rw_lock* lock);
 void write_lock(rw_lock* lock);
 void rw_unlock(rw_lock* lock, UnlockType type, UnlockStrategy strategy);
 
+/* Phase-fair read-write lock: reader and writer phases alternate while
+ * both sides wait, so a writer waits for at most one reader phase and a
+ * reader for at most one writer.  Writers are served in ticket order. */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t read_cond;
+    pthread_cond_t write_cond;
+    int active_readers;
+    int waiting_readers;
+    int active_writers;
+    unsigned read_phase;
+    unsigned write_ticket;
+    unsigned write_serving;
+} pf_rwlock;
+
+void init_pf_rwlock(pf_rwlock* lock);
+void destroy_pf_rwlock(pf_rwlock* lock);
+void pf_read_lock(pf_rwlock* lock);
+void pf_write_lock(pf_rwlock* lock);
+void pf_rw_unlock(pf_rwlock* lock, UnlockType type);
+
 #endif // RWLOCKS_H
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sorted_array.h"
+
+/* Read-optimised set: a sorted array searched without branches, plus a
+ * small sorted delta of the writes since the last merge.
+ *
+ * Readers take no locks: they announce the current epoch in their
+ * reader slot, load the current version, search its delta and then its
+ * base, and clear the slot.  Writers serialise on write_mutex, build a
+ * new version (copying the delta, or merging it into a new base array
+ * once it holds SA_DELTA_MAX entries) and publish it with one atomic
+ * pointer swap.  Replaced versions and bases are retired with the epoch
+ * of the swap and freed once no reader announced that epoch or an
+ * earlier one. */
+
+static atomic_int next_slot;
+static __thread int reader_slot = -1;
+
+/* Index of the first key >= value in keys[0..n), without branches in
+ * the loop (the comparison compiles to a conditional move) */
+static inline int lower_bound(const int* keys, int n, int value) {
+    const int* base = keys;
+    int half;
+
+    if (n == 0) return 0;
+    while (n > 1) {
+        half = n / 2;
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+        base = (base[half] < value) ? base + half : base;
+        n -= half;
+    }
+    return (base - keys) + (*base < value);
+}
+
+static sa_base* new_base(int n) {
+    sa_base* base = malloc(sizeof(sa_base) + n*sizeof(int));
+    base->n = n;
+    return base;
+}
+
+static sa_reader* my_reader(sorted_array* set) {
+    if (reader_slot < 0) {
+        reader_slot = atomic_fetch_add(&next_slot, 1);
+        if (reader_slot >= SA_MAX_THREADS) {
+            fprintf(stderr, "sorted_array: more than %d threads\n", SA_MAX_THREADS);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return &set->readers[reader_slot];
+}
+
+/* 1 if value is in version v, 0 otherwise */
+static int version_member(const sa_version* v, int value) {
+    int i = lower_bound(v->delta_keys, v->delta_n, value);
+
+    if (i < v->delta_n && v->delta_keys[i] == value)
+        return v->delta_present[i];
+    i = lower_bound(v->base->keys, v->base->n, value);
+    return i < v->base->n && v->base->keys[i] == value;
+}
+
+/* Retire ptr, replaced by the version just published, and free what no
+ * reader can still see.  Caller holds write_mutex. */
+static void retire(sorted_array* set, void* ptr) {
+    sa_retired* r = malloc(sizeof(sa_retired));
+    sa_retired** link;
+    unsigned long oldest, e;
+    int t, slots = atomic_load(&next_slot);
+
+    /* Readers that announce a later epoch load the new version */
+    r->ptr = ptr;
+    r->epoch = atomic_fetch_add(&set->epoch, 1);
+    r->next = set->retired;
+    set->retired = r;
+
+    oldest = atomic_load(&set->epoch);
+    if (slots > SA_MAX_THREADS) slots = SA_MAX_THREADS;
+    for (t = 0; t < slots; t++) {
+        e = atomic_load(&set->readers[t].epoch);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+    link = &set->retired;
+    while (*link != NULL) {
+        r = *link;
+        if (r->epoch < oldest) {
+            *link = r->next;
+            free(r->ptr);
+            free(r);
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+/* Publish a copy of the current version with value set to present,
+ * merging the delta into a new base first if it is full.  Caller holds
+ * write_mutex and has checked that the write changes the set. */
+static void publish(sorted_array* set, int value, int present) {
+    sa_version* old = atomic_load(&set->current);
+    sa_version* v = malloc(sizeof(sa_version));
+    sa_base* base = old->base;
+    sa_base* merged;
+    int i, j, k, n;
+
+    if (old->delta_n == SA_DELTA_MAX) {
+        /* Merge: at most delta_n keys are added */
+        merged = new_base(base->n + old->delta_n);
+        for (i = j = n = 0; i < base->n || j < old->delta_n; ) {
+            if (j == old->delta_n || (i < base->n && base->keys[i] < old->delta_keys[j])) {
+                merged->keys[n++] = base->keys[i++];
+            } else {
+                if (i < base->n && base->keys[i] == old->delta_keys[j]) i++;
+                if (old->delta_present[j]) merged->keys[n++] = old->delta_keys[j];
+                j++;
+            }
+        }
+        merged->n = n;
+        v->base = merged;
+        v->delta_n = 0;
+        set->merges++;
+    } else {
+        v->base = base;
+        v->delta_n = old->delta_n;
+        memcpy(v->delta_keys, old->delta_keys, old->delta_n*sizeof(int));
+        memcpy(v->delta_present, old->delta_present, old->delta_n);
+    }
+
+    k = lower_bound(v->delta_keys, v->delta_n, value);
+    if (k == v->delta_n || v->delta_keys[k] != value) {
+        memmove(&v->delta_keys[k+1], &v->delta_keys[k], (v->delta_n - k)*sizeof(int));
+        memmove(&v->delta_present[k+1], &v->delta_present[k], v->delta_n - k);
+        v->delta_keys[k] = value;
+        v->delta_n++;
+    }
+    v->delta_present[k] = present;
+
+    atomic_store(&set->current, v);
+    retire(set, old);
+    if (v->base != base) retire(set, base);
+}
+
+void init_sorted_array(sorted_array* set) {
+    sa_version* v = malloc(sizeof(sa_version));
+    int t;
+
+    v->base = new_base(0);
+    v->delta_n = 0;
+    atomic_init(&set->current, v);
+    atomic_init(&set->epoch, 1);
+    pthread_mutex_init(&set->write_mutex, NULL);
+    set->retired = NULL;
+    set->merges = 0;
+    for (t = 0; t < SA_MAX_THREADS; t++)
+        atomic_init(&set->readers[t].epoch, 0);
+}
+
+void destroy_sorted_array(sorted_array* set) {
+    sa_version* v = atomic_load(&set->current);
+    sa_retired* r;
+
+    while (set->retired != NULL) {
+        r = set->retired;
+        set->retired = r->next;
+        free(r->ptr);
+        free(r);
+    }
+    free(v->base);
+    free(v);
+    pthread_mutex_destroy(&set->write_mutex);
+}
+
+/* Replace the contents of an unshared set with keys[0..n), which must
+ * be sorted and free of duplicates */
+void sorted_bulk_load(sorted_array* set, const int keys[], int n) {
+    sa_version* v = atomic_load(&set->current);
+
+    free(v->base);
+    v->base = new_base(n);
+    memcpy(v->base->keys, keys, n*sizeof(int));
+    v->delta_n = 0;
+}
+
+int sorted_member(sorted_array* set, int value) {
+    sa_reader* me = my_reader(set);
+    int found;
+
+    atomic_store(&me->epoch, atomic_load(&set->epoch));
+    found = version_member(atomic_load(&set->current), value);
+    atomic_store_explicit(&me->epoch, 0, memory_order_release);
+    return found;
+}
+
+int sorted_insert(sorted_array* set, int value) {
+    int done = 0;
+
+    pthread_mutex_lock(&set->write_mutex);
+    if (!version_member(atomic_load(&set->current), value)) {
+        publish(set, value, 1);
+        done = 1;
+    }
+    pthread_mutex_unlock(&set->write_mutex);
+    return done;
+}
+
+int sorted_delete(sorted_array* set, int value) {
+    int done = 0;
+
+    pthread_mutex_lock(&set->write_mutex);
+    if (version_member(atomic_load(&set->current), value)) {
+        publish(set, value, 0);
+        done = 1;
+    }
+    pthread_mutex_unlock(&set->write_mutex);
+    return done;
+}
@@ -0,0 +1,53 @@
+#ifndef SORTED_ARRAY_H
+#define SORTED_ARRAY_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define SA_DELTA_MAX    64      /* buffered writes that trigger a merge */
+#define SA_MAX_THREADS  256     /* threads that may ever read a set */
+
+/* Immutable sorted array of keys, shared by every version built on it */
+typedef struct {
+    int n;
+    int keys[];
+} sa_base;
+
+/* Immutable version of the set: a base array plus the writes since the
+ * last merge, sorted by key.  A delta entry overrides the base: present
+ * 1 means the key is in the set, 0 that it was deleted. */
+typedef struct {
+    sa_base* base;
+    int delta_n;
+    int delta_keys[SA_DELTA_MAX];
+    unsigned char delta_present[SA_DELTA_MAX];
+} sa_version;
+
+typedef struct sa_retired {
+    void* ptr;
+    unsigned long epoch;
+    struct sa_retired* next;
+} sa_retired;
+
+/* Epoch a reader announced while it looks at a version, 0 when idle */
+typedef struct {
+    atomic_ulong epoch;
+} __attribute__((aligned(64))) sa_reader;
+
+typedef struct {
+    _Atomic(sa_version*) current;
+    atomic_ulong epoch;
+    pthread_mutex_t write_mutex;
+    sa_retired* retired;        /* protected by write_mutex */
+    long merges;
+    sa_reader readers[SA_MAX_THREADS];
+} sorted_array;
+
+void init_sorted_array(sorted_array* set);
+void destroy_sorted_array(sorted_array* set);
+void sorted_bulk_load(sorted_array* set, const int keys[], int n);
+int  sorted_insert(sorted_array* set, int value);
+int  sorted_member(sorted_array* set, int value);
+int  sorted_delete(sorted_array* set, int value);
+
+#endif // SORTED_ARRAY_H
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+#include "unrolled_list.h"
+
+/* Unrolled sorted list.  Nodes are never empty; a full node is split in
+ * half on insert and a node that drops below a quarter full absorbs its
+ * successor when both fit in one node.  Traversal prefetches the next
+ * node (both cache lines) before looking at the keys of the current one. */
+
+static unrolled_node* new_node(void) {
+    unrolled_node* node = aligned_alloc(UL_CACHE_LINE, sizeof(unrolled_node));
+    node->next = NULL;
+    node->count = 0;
+    return node;
+}
+
+static inline void prefetch_node(const unrolled_node* node) {
+    if (node != NULL) {
+        __builtin_prefetch(node);
+        __builtin_prefetch((const char*) node + UL_CACHE_LINE);
+    }
+}
+
+/* Node that holds value if it is in the list: the first node whose last
+ * key is >= value, or the last node.  *pred_p gets its predecessor. */
+static unrolled_node* find_node(unrolled_list* list, int value,
+                                unrolled_node** pred_p) {
+    unrolled_node* pred = NULL;
+    unrolled_node* curr = list->head;
+
+    while (curr != NULL) {
+        prefetch_node(curr->next);
+        if (curr->next == NULL || curr->keys[curr->count-1] >= value)
+            break;
+        pred = curr;
+        curr = curr->next;
+    }
+    if (pred_p != NULL) *pred_p = pred;
+    return curr;
+}
+
+/* Index of the first key >= value in node */
+static inline int position(const unrolled_node* node, int value) {
+    int i = 0;
+    while (i < node->count && node->keys[i] < value)
+        i++;
+    return i;
+}
+
+void init_unrolled_list(unrolled_list* list) {
+    list->head = NULL;
+}
+
+void destroy_unrolled_list(unrolled_list* list) {
+    unrolled_node* curr = list->head;
+    unrolled_node* following;
+
+    while (curr != NULL) {
+        following = curr->next;
+        free(curr);
+        curr = following;
+    }
+    list->head = NULL;
+}
+
+int unrolled_member(unrolled_list* list, int value) {
+    unrolled_node* node = find_node(list, value, NULL);
+    int i;
+
+    if (node == NULL) return 0;
+    i = position(node, value);
+    return i < node->count && node->keys[i] == value;
+}
+
+/* Member for count values, with up to width lookups interleaved: each
+ * round moves every lookup one node forward and prefetches the node it
+ * will look at next, so the misses of different lookups overlap.  A
+ * finished lookup's slot is refilled with the next value. */
+void unrolled_member_batch(unrolled_list* list, const int values[],
+                           int results[], int count, int width) {
+    unrolled_node* node[UL_MAX_WIDTH];
+    int which[UL_MAX_WIDTH];
+    int s, i, v, next = 0, active = 0;
+
+    if (width > UL_MAX_WIDTH) width = UL_MAX_WIDTH;
+    if (width < 1) width = 1;
+    prefetch_node(list->head);
+    for (s = 0; s < width; s++) {
+        which[s] = next < count ? next++ : -1;
+        node[s] = list->head;
+        if (which[s] >= 0) active++;
+    }
+
+    while (active > 0) {
+        for (s = 0; s < width; s++) {
+            if (which[s] < 0) continue;
+            v = values[which[s]];
+            if (node[s] != NULL && node[s]->next != NULL &&
+                    node[s]->keys[node[s]->count-1] < v) {
+                node[s] = node[s]->next;
+                prefetch_node(node[s]);
+                continue;
+            }
+            /* node[s] holds v if it is in the list */
+            if (node[s] == NULL) {
+                results[which[s]] = 0;
+            } else {
+                i = position(node[s], v);
+                results[which[s]] = i < node[s]->count && node[s]->keys[i] == v;
+            }
+            if (next < count) {
+                which[s] = next++;
+                node[s] = list->head;
+            } else {
+                which[s] = -1;
+                active--;
+            }
+        }
+    }
+}
+
+int unrolled_insert(unrolled_list* list, int value) {
+    unrolled_node* node;
+    unrolled_node* fresh;
+    int i, half;
+
+    if (list->head == NULL) {
+        list->head = new_node();
+        list->head->keys[0] = value;
+        list->head->count = 1;
+        return 1;
+    }
+
+    node = find_node(list, value, NULL);
+    i = position(node, value);
+    if (i < node->count && node->keys[i] == value)
+        return 0;
+
+    if (node->count == (int) UL_CAPACITY) {
+        /* Split: move the upper half into a new successor */
+        fresh = new_node();
+        half = node->count / 2;
+        fresh->count = node->count - half;
+        memcpy(fresh->keys, &node->keys[half], fresh->count * sizeof(int));
+        node->count = half;
+        fresh->next = node->next;
+        node->next = fresh;
+        if (i > half) {
+            node = fresh;
+            i -= half;
+        }
+    }
+
+    memmove(&node->keys[i+1], &node->keys[i], (node->count - i) * sizeof(int));
+    node->keys[i] = value;
+    node->count++;
+    return 1;
+}
+
+int unrolled_delete(unrolled_list* list, int value) {
+    unrolled_node* pred;
+    unrolled_node* node = find_node(list, value, &pred);
+    unrolled_node* following;
+    int i;
+
+    if (node == NULL) return 0;
+    i = position(node, value);
+    if (i == node->count || node->keys[i] != value)
+        return 0;
+
+    node->count--;
+    memmove(&node->keys[i], &node->keys[i+1], (node->count - i) * sizeof(int));
+
+    following = node->next;
+    if (node->count == 0) {
+        if (pred == NULL)
+            list->head = following;
+        else
+            pred->next = following;
+        free(node);
+    } else if (node->count < (int) UL_CAPACITY / 4 && following != NULL &&
+               node->count + following->count <= (int) UL_CAPACITY) {
+        /* Merge: absorb the successor */
+        memcpy(&node->keys[node->count], following->keys,
+               following->count * sizeof(int));
+        node->count += following->count;
+        node->next = following->next;
+        free(following);
+    }
+    return 1;
+}
@@ -0,0 +1,32 @@
+#ifndef UNROLLED_LIST_H
+#define UNROLLED_LIST_H
+
+/* Bytes per node, a multiple of the cache line size */
+#ifndef UL_NODE_BYTES
+#define UL_NODE_BYTES 128
+#endif
+#define UL_CACHE_LINE 64
+#define UL_CAPACITY ((UL_NODE_BYTES - sizeof(void*) - sizeof(int)) / sizeof(int))
+/* Most lookups unrolled_member_batch keeps in flight */
+#define UL_MAX_WIDTH 64
+
+/* Sorted list node holding up to UL_CAPACITY keys in ascending order */
+typedef struct unrolled_node {
+    struct unrolled_node* next;
+    int count;
+    int keys[UL_CAPACITY];
+} unrolled_node;
+
+typedef struct {
+    unrolled_node* head;
+} unrolled_list;
+
+void init_unrolled_list(unrolled_list* list);
+void destroy_unrolled_list(unrolled_list* list);
+int  unrolled_insert(unrolled_list* list, int value);
+int  unrolled_member(unrolled_list* list, int value);
+int  unrolled_delete(unrolled_list* list, int value);
+void unrolled_member_batch(unrolled_list* list, const int values[],
+                           int results[], int count, int width);
+
+#endif // UNROLLED_LIST_H
@@ -0,0 +1,88 @@
+#include <math.h>
+#include "../my_rand.h"
+#include "workload.h"
+
+/* Exact generalised harmonic numbers are summed up to this many
+ * terms; the rest is approximated by an integral */
+#define ZETA_EXACT_TERMS 1000000
+
+/* zeta(n, theta) = sum_{i=1}^{n} 1/i^theta */
+static double zeta(long n, double theta) {
+    long m = n < ZETA_EXACT_TERMS ? n : ZETA_EXACT_TERMS;
+    double sum = 0.0;
+    long i;
+
+    for (i = 1; i <= m; i++)
+        sum += pow((double) i, -theta);
+    if (n > m)
+        sum += (pow(n + 0.5, 1.0 - theta) - pow(m + 0.5, 1.0 - theta)) / (1.0 - theta);
+    return sum;
+}
+
+/* One round of a bijection on [0, mask]: an odd multiplier and an
+ * xorshift are each invertible modulo a power of two */
+static inline unsigned permute(const workload* w, unsigned x) {
+    x = (x * 2654435761u + 0x9e3779b9u) & w->perm_mask;
+    return x ^ (x >> w->perm_shift);
+}
+
+/* A permutation of [0, key_range): apply the bijection on the
+ * enclosing power of two until the value falls back in range.  Since
+ * key_range > mask/2, this takes under two rounds on average. */
+static inline int scramble(const workload* w, long rank) {
+    unsigned x = permute(w, (unsigned) rank);
+
+    while (x >= (unsigned) w->key_range)
+        x = permute(w, x);
+    return (int) x;
+}
+
+void init_workload(workload* w, Key_dist dist, int key_range, double theta,
+                   double hot_fraction, double hot_op_fraction) {
+    int bits;
+
+    w->dist = dist;
+    w->key_range = key_range;
+    w->theta = theta;
+    w->hot_op_fraction = hot_op_fraction;
+    w->hot_count = (int) (hot_fraction * key_range);
+    if (w->hot_count < 1) w->hot_count = 1;
+    for (w->perm_mask = 1, bits = 1; w->perm_mask < (unsigned) key_range - 1; bits++)
+        w->perm_mask = (w->perm_mask << 1) | 1;
+    w->perm_shift = (bits + 1)/2;
+
+    if (dist == DIST_ZIPF) {
+        /* Gray et al., "Quickly generating billion-record synthetic
+         * databases", as used by YCSB */
+        w->zetan = zeta(key_range, theta);
+        w->alpha = 1.0 / (1.0 - theta);
+        w->eta = (1.0 - pow(2.0 / key_range, 1.0 - theta)) /
+                 (1.0 - zeta(2, theta) / w->zetan);
+    }
+}
+
+int next_key(const workload* w, unsigned* seed_p) {
+    double u, uz;
+    long rank;
+
+    switch (w->dist) {
+    case DIST_ZIPF:
+        u = my_drand(seed_p);
+        uz = u * w->zetan;
+        if (uz < 1.0)
+            rank = 0;
+        else if (uz < 1.0 + pow(0.5, w->theta))
+            rank = 1;
+        else
+            rank = (long) (w->key_range * pow(w->eta * u - w->eta + 1.0, w->alpha));
+        if (rank >= w->key_range) rank = w->key_range - 1;
+        return scramble(w, rank);
+    case DIST_HOTSET:
+        u = my_drand(seed_p);
+        if (u < w->hot_op_fraction)
+            return scramble(w, my_rand(seed_p) % w->hot_count);
+        return my_rand(seed_p) % w->key_range;
+    default:
+        return my_rand(seed_p) % w->key_range;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+typedef enum {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_HOTSET
+} Key_dist;
+
+/* Key generator for the op-mix driver.  Keys are in [0, key_range).
+ * Zipfian ranks and hot-set members are scattered over the key range
+ * so that popular keys are not all at the front of a sorted list. */
+typedef struct {
+    Key_dist dist;
+    int key_range;
+    /* DIST_ZIPF: skew 0 < theta < 1 */
+    double theta, alpha, zetan, eta;
+    /* DIST_HOTSET: hot_op_fraction of the ops go to hot_count keys */
+    double hot_op_fraction;
+    int hot_count;
+    /* Zipfian ranks and hot-set indices are mapped to keys by a
+     * permutation built on the smallest 2^bits - 1 >= key_range - 1 */
+    unsigned perm_mask;
+    int perm_shift;
+} workload;
+
+void init_workload(workload* w, Key_dist dist, int key_range, double theta,
+                   double hot_fraction, double hot_op_fraction);
+int  next_key(const workload* w, unsigned* seed_p);
+
+#endif // WORKLOAD_H
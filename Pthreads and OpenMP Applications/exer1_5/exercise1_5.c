@@ -1,46 +1,140 @@
 /* File:     exercise1_5.c
  *
  * Purpose:  Compare pthread mutexes with atomic instructions
- * 
+ *
  * Compile:  make all  (needs timer.h, my_rand.h)
- * 
- * Usage:    make run ARGS="<thread_count> <num_iter> <approach>"
- * 
+ *
+ * Usage:    make run ARGS="[-c cs_work] [-n ncs_work] [-d seconds] [-b bucket_ms] <thread_count> <num_iter> <approach> [read_every] [threshold]"
+ *
  * Input:    Number of threads
  *           Number of iterations
- *           Approach type: 0 for mutexes or 1 for atomic instuctions
- * 
- * Output:   Elapsed time for the two approaches
+ *           Approach type: 0 for mutexes, 1 for atomic instuctions,
+ *           2 for per-thread counter shards, 3 for sloppy counter,
+ *           4 TAS lock, 5 TTAS lock with exponential backoff,
+ *           6 ticket lock, 7 MCS lock, 8 CLH lock, 9 pthread spinlock,
+ *           10 relaxed atomic increment, 11 compare-and-swap loop
+ *           Read frequency: each thread reads the counter every
+ *           read_every increments (0, the default, for never)
+ *           Threshold: local increments a sloppy counter keeps before
+ *           flushing them to the shared variable
+ *           -c: units of work done inside the critical section
+ *           -n: units of work done between acquisitions
+ *           -d: run for this many seconds instead of num_iter
+ *           iterations
+ *           -b: width of the throughput time buckets in ms (default 100)
+ *
+ * Output:   Elapsed time for the approaches, update throughput and
+ *           the average cost of a read.  With -d also ops/sec per time
+ *           bucket, each thread's share of the ops and Jain's fairness
+ *           index, appended to Timeline1_5.csv and Fairness1_5.csv
+ *
+ * Notes:
+ *    1.  Shards are padded to a cache line each.  A thread only
+ *        writes its own shard; a read sums all of them.
+ *    2.  The sloppy counter reads only the shared variable, which
+ *        lags the true count by less than thread_count*threshold.
+ *    3.  -c and -n apply to approaches 0, 1 and 4-11.  The atomic
+ *        approaches (1, 10, 11) hold no lock, so their "critical
+ *        section" work is done just before the increment.
+ *    4.  The spin locks yield the CPU every few dozen polls, so
+ *        they still make progress with more threads than cores.
+ *    5.  With -d every thread checks a stop flag on each iteration and
+ *        the clock every PROGRESS_CHECK iterations, crediting the ops
+ *        done since its last check to the current bucket.  The
+ *        iterations column of Results1_5.csv then holds the ops done.
  *
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdatomic.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include "../timer.h"
+#include "spinlocks.h"
+
+#define CACHE_LINE 64
+/* Local increments of a sloppy counter, unless given on the command line */
+#define DEFAULT_THRESHOLD 64
+/* Iterations between clock reads in fixed-duration mode */
+#define PROGRESS_CHECK 256
+#define DEFAULT_BUCKET_MS 100
 
+/* One thread's part of the count, alone on its cache line */
+typedef struct {
+    atomic_long value;
+} __attribute__((aligned(CACHE_LINE))) counter_shard;
+
+/* A thread's queue nodes for the MCS and CLH locks */
+typedef struct {
+    mcs_node qnode;
+    clh_node* clh;
+    clh_node* clh_pred;
+} zoo_ctx;
+
+/* Ops a thread has credited to the time buckets so far */
+typedef struct {
+    long long int done;
+} __attribute__((aligned(CACHE_LINE))) thread_progress;
 
 /*Global variables*/
 pthread_mutex_t mutex;
 int thread_count, approach;
-atomic_int shared_variable;
+atomic_long shared_variable;
 double start, finish, elapsed;
 long long int total_iterations;
+counter_shard* shards;
+long long int read_every = 0;
+int threshold = DEFAULT_THRESHOLD;
+/* Reads done and time spent in them, summed under mutex */
+long long int total_reads;
+double read_time;
+/* Work inside and between critical sections */
+int cs_work = 0, ncs_work = 0;
+/* The lock zoo, approaches 4-9 */
+tas_lock tas;
+ttas_lock ttas;
+ticket_lock ticket;
+mcs_lock mcs;
+clh_lock clh;
+pthread_spinlock_t spin;
+/* Fixed-duration mode: run length, bucket width, stop flag and */
+/* ops per thread per bucket (bucket_ops[rank*bucket_count + b]) */
+double duration = 0.0, run_start;
+int bucket_ms = DEFAULT_BUCKET_MS, bucket_count;
+atomic_int stop;
+long long int* bucket_ops;
+thread_progress* progress;
 
 /* Serial functions */
 void output_csv(FILE *fp, const char *algorithm, double elapsed_time);
 void Usage (char* program_name);
 void Get_args(int argc, char *argv[]);
+double run_threads(void* (*thread_func)(void*));
+long sum_shards(void);
+void add_read_stats(long long int reads, double time);
+void init_locks(void);
+void destroy_locks(void);
+void Report_fairness(const char* label);
 
 /*Parallel Functions*/
 void* mutex_lock(void* rank);
 void* atomic(void* rank);
+void* sharded(void* rank);
+void* sloppy(void* rank);
+void* lock_zoo(void* rank);
+
+static const char* zoo_names[] = {
+    "tas", "ttas", "ticket", "mcs", "clh", "spinlock",
+    "atomic_relaxed", "cas"
+};
 
 
 
 int main(int argc, char* argv[]) {
-    long thread;
-    pthread_t* thread_handles;
+    char label[80];
+    int len;
+    long long int ops;
 
     Get_args(argc, argv);
     FILE *fp = fopen("Results1_5.csv", "a");
@@ -49,89 +143,436 @@ int main(int argc, char* argv[]) {
         exit(EXIT_FAILURE);
     }
 	/*csv records: Approach, total_iterations, thread_count, Elapsed_Time*/
-    
-    
-    thread_handles=malloc(thread_count*sizeof(pthread_t));
+
+
 	pthread_mutex_init(&mutex, NULL);
+    init_locks();
     shared_variable = 0;
+    shards = aligned_alloc(CACHE_LINE, thread_count*sizeof(counter_shard));
+    for (int t = 0; t < thread_count; t++)
+        atomic_init(&shards[t].value, 0);
+    if (duration > 0) {
+        bucket_count = (int)(duration*1000/bucket_ms) + 1;
+        bucket_ops = calloc((size_t)thread_count*bucket_count, sizeof(long long int));
+        progress = aligned_alloc(CACHE_LINE, thread_count*sizeof(thread_progress));
+        for (int t = 0; t < thread_count; t++)
+            progress[t].done = 0;
+    }
 
     if (approach==0){
     /*mutex approach*/
-        GET_TIME(start);
-        for (thread = 0; thread < thread_count; thread++) {
-            pthread_create(&thread_handles[thread], NULL, mutex_lock, (void*)thread);
-        }
-        
-        for (thread = 0; thread < thread_count; thread++) {
-            pthread_join(thread_handles[thread], NULL);
-        }
-        GET_TIME(finish);
-        elapsed = finish - start;
-        output_csv(fp, "mutex", elapsed);
-        
-    } else {
+        elapsed = run_threads(mutex_lock);
+        len = snprintf(label, sizeof(label), "mutex");
+    } else if (approach==1){
         /*atomic approach*/
-        GET_TIME(start);
-        for (thread = 0; thread < thread_count; thread++) {
-            pthread_create(&thread_handles[thread], NULL, atomic, (void*)thread);
-        }
-        
-        for (thread = 0; thread < thread_count; thread++) {
-            pthread_join(thread_handles[thread], NULL);
-        }
-        GET_TIME(finish);
-        elapsed = finish - start;
-        output_csv(fp, "atomic", elapsed);
+        elapsed = run_threads(atomic);
+        len = snprintf(label, sizeof(label), "atomic");
+    } else if (approach==2){
+        /*per-thread shards, summed on read*/
+        elapsed = run_threads(sharded);
+        shared_variable = sum_shards();
+        len = snprintf(label, sizeof(label), "sharded");
+    } else if (approach==3){
+        /*sloppy counter: local deltas flushed every threshold increments*/
+        elapsed = run_threads(sloppy);
+        len = snprintf(label, sizeof(label), "sloppy%d", threshold);
+    } else {
+        /*spin locks, pthread spinlock and lock-free increments*/
+        elapsed = run_threads(lock_zoo);
+        len = snprintf(label, sizeof(label), "%s", zoo_names[approach - 4]);
+    }
+    if (cs_work > 0 || ncs_work > 0)
+        len += snprintf(label + len, sizeof(label) - len, "_cs%d_ncs%d",
+                        cs_work, ncs_work);
+    if (read_every > 0)
+        len += snprintf(label + len, sizeof(label) - len, "_r%lld", read_every);
+    if (duration > 0) {
+        snprintf(label + len, sizeof(label) - len, "_d%g", duration);
+        ops = 0;
+        for (int t = 0; t < thread_count; t++)
+            ops += progress[t].done;
+        total_iterations = ops;
+    } else {
+        ops = (total_iterations/thread_count)*thread_count;
     }
+    output_csv(fp, label, elapsed);
 
-	free(thread_handles);
-	pthread_mutex_destroy(&mutex);
+    printf("%s done in %e seconds\n", label, elapsed);
+    printf("Update throughput: %e increments/sec\n", ops/elapsed);
+    if (duration > 0) Report_fairness(label);
+    if (total_reads > 0)
+        printf("Reads: %lld, average read cost: %.1f ns\n", total_reads,
+               read_time/total_reads*1e9);
+
+    free(shards);
+    free(bucket_ops);
+    free(progress);
+    destroy_locks();
+    pthread_mutex_destroy(&mutex);
     fclose(fp);
 
-    printf("Final value of shared variable: %d\n", shared_variable);
-    
+    printf("Final value of shared variable: %ld\n", (long) shared_variable);
+
     return 0;
 }
 
+/* Seconds on a clock fine enough to time a single read */
+static inline double read_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+/* Start thread_count threads running thread_func, wait for them */
+/* and return the elapsed time                                   */
+double run_threads(void* (*thread_func)(void*)) {
+    long thread;
+    pthread_t* thread_handles = malloc(thread_count*sizeof(pthread_t));
+    struct timespec nap;
+
+    atomic_store(&stop, 0);
+    GET_TIME(start);
+    run_start = read_clock();
+    for (thread = 0; thread < thread_count; thread++) {
+        pthread_create(&thread_handles[thread], NULL, thread_func, (void*)thread);
+    }
+    if (duration > 0) {
+        nap.tv_sec = (time_t) duration;
+        nap.tv_nsec = (long)((duration - nap.tv_sec)*1e9);
+        while (nanosleep(&nap, &nap) != 0)
+            ;
+        atomic_store(&stop, 1);
+    }
+
+    for (thread = 0; thread < thread_count; thread++) {
+        pthread_join(thread_handles[thread], NULL);
+    }
+    GET_TIME(finish);
+    free(thread_handles);
+    return finish - start;
+}
+
+/* Busy work standing in for n units of computation */
+static inline void Work(int n) {
+    volatile int sink = 0;
+    for (int k = 0; k < n; k++) sink += k;
+}
+
+void init_locks(void) {
+    tas_init(&tas);
+    ttas_init(&ttas);
+    ticket_init(&ticket);
+    mcs_init(&mcs);
+    clh_init(&clh);
+    pthread_spin_init(&spin, PTHREAD_PROCESS_PRIVATE);
+}
+
+void destroy_locks(void) {
+    clh_destroy(&clh);
+    pthread_spin_destroy(&spin);
+}
+
+/* Credit the ops done since this thread's last check to the */
+/* current time bucket                                        */
+static void record_progress(long my_rank, long long int i) {
+    int b = (int)((read_clock() - run_start)*1000/bucket_ms);
+
+    if (b >= bucket_count) b = bucket_count - 1;
+    bucket_ops[my_rank*bucket_count + b] += i - progress[my_rank].done;
+    progress[my_rank].done = i;
+}
+
+/* Loop condition of the thread functions: i iterations are done */
+static inline int keep_going(long my_rank, long long int i,
+                             long long int my_iterations) {
+    if (duration <= 0) return i < my_iterations;
+    if (atomic_load_explicit(&stop, memory_order_relaxed)) {
+        record_progress(my_rank, i);
+        return 0;
+    }
+    if (i % PROGRESS_CHECK == 0) record_progress(my_rank, i);
+    return 1;
+}
+
+long sum_shards(void) {
+    long sum = 0;
+    for (int t = 0; t < thread_count; t++)
+        sum += atomic_load_explicit(&shards[t].value, memory_order_relaxed);
+    return sum;
+}
+
+void add_read_stats(long long int reads, double time) {
+    pthread_mutex_lock(&mutex);
+    total_reads += reads;
+    read_time += time;
+    pthread_mutex_unlock(&mutex);
+}
+
 void* mutex_lock(void* rank){
+    long my_rank = (long) rank;
 	long long int my_iterations = total_iterations / thread_count;
-    long long int i;
+    long long int i, reads = 0;
+    volatile long seen;
+    double t0, my_read_time = 0.0;
 
-	for(i=0; i < my_iterations; i++) {
+	for(i=0; keep_going(my_rank, i, my_iterations); i++) {
         pthread_mutex_lock(&mutex);
         shared_variable++;
+        Work(cs_work);
         pthread_mutex_unlock(&mutex);
+        Work(ncs_work);
+        if (read_every > 0 && (i + 1) % read_every == 0) {
+            t0 = read_clock();
+            pthread_mutex_lock(&mutex);
+            seen = shared_variable;
+            pthread_mutex_unlock(&mutex);
+            my_read_time += read_clock() - t0;
+            reads++;
+        }
 	}
+    (void) seen;
+    if (reads > 0) add_read_stats(reads, my_read_time);
  	return NULL;
 }
 
 void* atomic(void* rank) {
+    long my_rank = (long) rank;
     long long int my_iterations = total_iterations / thread_count;
-    long long int i;
-    for (i = 0; i < my_iterations; i++) {
+    long long int i, reads = 0;
+    volatile long seen;
+    double t0, my_read_time = 0.0;
+
+    for (i = 0; keep_going(my_rank, i, my_iterations); i++) {
+        Work(cs_work);
         atomic_fetch_add(&shared_variable, 1);
+        Work(ncs_work);
+        if (read_every > 0 && (i + 1) % read_every == 0) {
+            t0 = read_clock();
+            seen = atomic_load(&shared_variable);
+            my_read_time += read_clock() - t0;
+            reads++;
+        }
+    }
+    (void) seen;
+    if (reads > 0) add_read_stats(reads, my_read_time);
+    return NULL;
+}
+
+/* Only this thread writes its shard, so a plain load and store */
+/* replace the locked read-modify-write                         */
+void* sharded(void* rank) {
+    long my_rank = (long) rank;
+    long long int my_iterations = total_iterations / thread_count;
+    long long int i, reads = 0;
+    atomic_long* mine = &shards[my_rank].value;
+    volatile long seen;
+    double t0, my_read_time = 0.0;
+
+    for (i = 0; keep_going(my_rank, i, my_iterations); i++) {
+        atomic_store_explicit(mine,
+                atomic_load_explicit(mine, memory_order_relaxed) + 1,
+                memory_order_relaxed);
+        if (read_every > 0 && (i + 1) % read_every == 0) {
+            t0 = read_clock();
+            seen = sum_shards();
+            my_read_time += read_clock() - t0;
+            reads++;
+        }
+    }
+    (void) seen;
+    if (reads > 0) add_read_stats(reads, my_read_time);
+    return NULL;
+}
+
+/* Count locally, add to the shared variable every threshold */
+/* increments and once more at the end                       */
+void* sloppy(void* rank) {
+    long my_rank = (long) rank;
+    long long int my_iterations = total_iterations / thread_count;
+    long long int i, reads = 0;
+    int delta = 0;
+    volatile long seen;
+    double t0, my_read_time = 0.0;
+
+    for (i = 0; keep_going(my_rank, i, my_iterations); i++) {
+        if (++delta >= threshold) {
+            atomic_fetch_add(&shared_variable, delta);
+            delta = 0;
+        }
+        if (read_every > 0 && (i + 1) % read_every == 0) {
+            t0 = read_clock();
+            seen = atomic_load_explicit(&shared_variable, memory_order_relaxed);
+            my_read_time += read_clock() - t0;
+            reads++;
+        }
+    }
+    if (delta > 0) atomic_fetch_add(&shared_variable, delta);
+    (void) seen;
+    if (reads > 0) add_read_stats(reads, my_read_time);
+    return NULL;
+}
+
+static inline void zoo_acquire(zoo_ctx* ctx) {
+    switch (approach) {
+        case 4: tas_acquire(&tas); break;
+        case 5: ttas_acquire(&ttas); break;
+        case 6: ticket_acquire(&ticket); break;
+        case 7: mcs_acquire(&mcs, &ctx->qnode); break;
+        case 8: ctx->clh_pred = clh_acquire(&clh, ctx->clh); break;
+        default: pthread_spin_lock(&spin);
+    }
+}
+
+static inline void zoo_release(zoo_ctx* ctx) {
+    switch (approach) {
+        case 4: tas_release(&tas); break;
+        case 5: ttas_release(&ttas); break;
+        case 6: ticket_release(&ticket); break;
+        case 7: mcs_release(&mcs, &ctx->qnode); break;
+        case 8:
+            clh_release(ctx->clh);
+            ctx->clh = ctx->clh_pred;
+            break;
+        default: pthread_spin_unlock(&spin);
+    }
+}
+
+/* Approaches 4-11.  The locks guard a relaxed load and store of the */
+/* shared variable; 10 and 11 update it without a lock               */
+void* lock_zoo(void* rank) {
+    long my_rank = (long) rank;
+    long long int my_iterations = total_iterations / thread_count;
+    long long int i, reads = 0;
+    long old;
+    volatile long seen;
+    double t0, my_read_time = 0.0;
+    zoo_ctx ctx;
+
+    ctx.clh = (approach == 8) ? clh_new_node() : NULL;
+    for (i = 0; keep_going(my_rank, i, my_iterations); i++) {
+        if (approach == 10) {
+            Work(cs_work);
+            atomic_fetch_add_explicit(&shared_variable, 1, memory_order_relaxed);
+        } else if (approach == 11) {
+            Work(cs_work);
+            old = atomic_load_explicit(&shared_variable, memory_order_relaxed);
+            while (!atomic_compare_exchange_weak(&shared_variable, &old, old + 1))
+                ;
+        } else {
+            zoo_acquire(&ctx);
+            atomic_store_explicit(&shared_variable,
+                    atomic_load_explicit(&shared_variable, memory_order_relaxed) + 1,
+                    memory_order_relaxed);
+            Work(cs_work);
+            zoo_release(&ctx);
+        }
+        Work(ncs_work);
+        if (read_every > 0 && (i + 1) % read_every == 0) {
+            t0 = read_clock();
+            if (approach >= 10) {
+                seen = atomic_load(&shared_variable);
+            } else {
+                zoo_acquire(&ctx);
+                seen = atomic_load_explicit(&shared_variable, memory_order_relaxed);
+                zoo_release(&ctx);
+            }
+            my_read_time += read_clock() - t0;
+            reads++;
+        }
     }
+    free(ctx.clh);
+    (void) seen;
+    if (reads > 0) add_read_stats(reads, my_read_time);
     return NULL;
 }
 
+/* Ops/sec per time bucket, each thread's share of the ops and */
+/* Jain's index (sum x)^2/(n sum x^2): 1 when every thread did */
+/* the same number of ops, 1/n when one thread did them all    */
+void Report_fairness(const char* label) {
+    long long int total = 0, in_bucket;
+    double sum_sq = 0.0, share, min_share = 1.0, max_share = 0.0, jain;
+    FILE* fp;
+    int t, b;
+
+    printf("Throughput over time (%d ms buckets):\n", bucket_ms);
+    fp = fopen("Timeline1_5.csv", "a");
+    for (b = 0; b < bucket_count; b++) {
+        in_bucket = 0;
+        for (t = 0; t < thread_count; t++)
+            in_bucket += bucket_ops[t*bucket_count + b];
+        if (b == bucket_count - 1 && in_bucket == 0) break;
+        printf("   %8.3f s  %e ops/sec\n", b*bucket_ms/1000.0,
+               in_bucket*1000.0/bucket_ms);
+        if (fp != NULL)
+            fprintf(fp, "%s,%d,%.3f,%e\n", label, thread_count,
+                    b*bucket_ms/1000.0, in_bucket*1000.0/bucket_ms);
+    }
+    if (fp != NULL) fclose(fp);
+
+    for (t = 0; t < thread_count; t++) {
+        total += progress[t].done;
+        sum_sq += (double) progress[t].done*progress[t].done;
+    }
+    printf("Per-thread share of ops:\n");
+    for (t = 0; t < thread_count; t++) {
+        share = total > 0 ? (double) progress[t].done/total : 0.0;
+        if (share < min_share) min_share = share;
+        if (share > max_share) max_share = share;
+        printf("   thread %d: %lld ops (%.1f%%)\n", t, progress[t].done,
+               100*share);
+    }
+    jain = sum_sq > 0 ? (double) total*total/(thread_count*sum_sq) : 1.0;
+    printf("Jain's fairness index: %.4f\n", jain);
+
+    fp = fopen("Fairness1_5.csv", "a");
+    if (fp != NULL) {
+        fprintf(fp, "%s,%d,%e,%.4f,%.4f,%.4f\n", label, thread_count,
+                duration, jain, min_share, max_share);
+        fclose(fp);
+    }
+}
+
 void output_csv(FILE *fp, const char *algorithm, double elapsed_time) {
-    fprintf(fp, "%s,%lld,%d,%e\n", algorithm, total_iterations, 
+    fprintf(fp, "%s,%lld,%d,%e\n", algorithm, total_iterations,
 			thread_count, elapsed_time);
 }
 
 void Get_args(int argc, char* argv[]){
-   if (argc != 4) Usage(argv[0]);
+   int opt;
+   char* program_name = argv[0];
+
+   while ((opt = getopt(argc, argv, "c:n:d:b:")) != -1) {
+      switch (opt) {
+         case 'c': cs_work = strtol(optarg, NULL, 10); break;
+         case 'n': ncs_work = strtol(optarg, NULL, 10); break;
+         case 'd': duration = strtod(optarg, NULL); break;
+         case 'b': bucket_ms = strtol(optarg, NULL, 10); break;
+         default: Usage(program_name);
+      }
+   }
+   argc -= optind - 1;
+   argv += optind - 1;
+
+   if (argc < 4 || argc > 6) Usage(program_name);
    thread_count= strtol(argv[1], NULL, 10);
    total_iterations = strtol(argv[2], NULL, 10);
    approach = strtol(argv[3], NULL, 10);
-   if (thread_count <= 0 || total_iterations <= 0) Usage(argv[0]);
-    if (approach != 0 && approach != 1) {
-    fprintf(stderr, "Error: Approach must be 0 for mutexes or 1 for atomic instructions.\n");
+   if (argc >= 5) read_every = strtol(argv[4], NULL, 10);
+   if (argc == 6) threshold = strtol(argv[5], NULL, 10);
+   if (thread_count <= 0 || total_iterations <= 0 || read_every < 0 ||
+       threshold <= 0 || cs_work < 0 || ncs_work < 0 || duration < 0 ||
+       bucket_ms <= 0) Usage(program_name);
+    if (approach < 0 || approach > 11) {
+    fprintf(stderr, "Error: Approach must be 0 for mutexes, 1 for atomic instructions,\n"
+                    "2 for counter shards, 3 for a sloppy counter, 4-8 for the TAS,\n"
+                    "TTAS, ticket, MCS and CLH locks, 9 for a pthread spinlock,\n"
+                    "10 for relaxed atomics or 11 for a CAS loop.\n");
     exit(EXIT_FAILURE);
 }
 }
 
 void Usage (char* program_name) {
-	fprintf(stderr, "Usage: %s <throw_num> <total_iterations> \n", program_name);
+	fprintf(stderr, "Usage: %s [-c cs_work] [-n ncs_work] [-d seconds] [-b bucket_ms] <thread_count> <total_iterations> <approach> [read_every] [threshold]\n", program_name);
    	exit(0);
-}
\ No newline at end of file
+}
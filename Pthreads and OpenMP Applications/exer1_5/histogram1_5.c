@@ -0,0 +1,256 @@
+/* File:     histogram1_5.c
+ *
+ * Purpose:  Compare ways of building a shared histogram when many
+ *           threads increment a few thousand bins with a skewed key
+ *           distribution
+ *
+ * Compile:  make all  (needs timer.h, my_rand.h)
+ *
+ * Usage:    ./histogram1_5 <thread_count> <num_samples> <approach> <bins> <skew> [hot_bins]
+ *
+ * Input:    Number of threads
+ *           Number of samples, split evenly among the threads
+ *           Approach type: 0 for atomic increments of one global
+ *           histogram, 1 for private histograms merged by a tree
+ *           reduction, 2 for a hybrid with private hot bins and
+ *           global cold bins
+ *           Number of bins
+ *           Skew: Zipf exponent of the bin distribution, 0 for uniform
+ *           Hot bins: bins the hybrid keeps private (default 64)
+ *
+ * Output:   Elapsed time and samples/sec, appended to Histogram1_5.csv
+ *           as algorithm,total_iterations,thread_count,elapsed like
+ *           Results1_5.csv
+ *
+ * Notes:
+ *    1.  Bin i is the (i+1)-th most likely bin, so the hot bins are
+ *        0..hot_bins-1.  A real hybrid would pick them from a profile.
+ *    2.  Each thread draws its samples before the timed section.  The
+ *        time includes the reduction.
+ *    3.  The tree reduction takes log2(thread_count) rounds: in round
+ *        r a thread whose rank is a multiple of 2^(r+1) adds in the
+ *        histogram of rank + 2^r.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <math.h>
+#include "../timer.h"
+#include "../my_rand.h"
+
+#define CACHE_LINE 64
+#define DEFAULT_HOT_BINS 64
+
+/*Global variables*/
+int thread_count, approach, bins, hot_bins = DEFAULT_HOT_BINS;
+long long int total_samples;
+double skew;
+double start, finish, elapsed;
+double* cdf;                /* cdf[i] = P(bin <= i) */
+atomic_long* global_hist;
+long** private_hist;        /* one per thread, hot bins only for the hybrid */
+pthread_barrier_t barrier;
+
+/* Serial functions */
+void output_csv(FILE *fp, const char *algorithm, double elapsed_time);
+void Usage (char* program_name);
+void Get_args(int argc, char *argv[]);
+void Build_cdf(void);
+int Draw_bin(unsigned* seed);
+long long int Check_total(void);
+
+/*Parallel Functions*/
+void* histogram(void* rank);
+void Tree_reduce(long my_rank, int width);
+
+static const char* approach_names[] = { "global", "private", "hybrid" };
+
+
+
+int main(int argc, char* argv[]) {
+    char label[64];
+    int len;
+    long thread;
+    pthread_t* thread_handles;
+    long long int total;
+    int width;
+
+    Get_args(argc, argv);
+    FILE *fp = fopen("Histogram1_5.csv", "a");
+    if (fp == NULL) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    Build_cdf();
+    global_hist = aligned_alloc(CACHE_LINE,
+            ((bins*sizeof(atomic_long) + CACHE_LINE - 1)/CACHE_LINE)*CACHE_LINE);
+    for (int b = 0; b < bins; b++)
+        atomic_init(&global_hist[b], 0);
+    width = (approach == 2) ? hot_bins : bins;
+    private_hist = malloc(thread_count*sizeof(long*));
+    for (thread = 0; thread < thread_count; thread++)
+        private_hist[thread] = aligned_alloc(CACHE_LINE,
+            ((width*sizeof(long) + CACHE_LINE - 1)/CACHE_LINE)*CACHE_LINE);
+    pthread_barrier_init(&barrier, NULL, thread_count);
+
+    thread_handles = malloc(thread_count*sizeof(pthread_t));
+    for (thread = 0; thread < thread_count; thread++)
+        pthread_create(&thread_handles[thread], NULL, histogram, (void*)thread);
+    for (thread = 0; thread < thread_count; thread++)
+        pthread_join(thread_handles[thread], NULL);
+    GET_TIME(finish);
+    elapsed = finish - start;
+
+    len = snprintf(label, sizeof(label), "%s_b%d_s%g",
+                   approach_names[approach], bins, skew);
+    if (approach == 2)
+        snprintf(label + len, sizeof(label) - len, "_h%d", hot_bins);
+    output_csv(fp, label, elapsed);
+
+    total = Check_total();
+    printf("%s done in %e seconds\n", label, elapsed);
+    printf("Throughput: %e samples/sec\n",
+           (total_samples/thread_count)*thread_count/elapsed);
+    printf("Samples in histogram: %lld of %lld\n", total,
+           (total_samples/thread_count)*thread_count);
+
+    for (thread = 0; thread < thread_count; thread++)
+        free(private_hist[thread]);
+    free(private_hist);
+    free(global_hist);
+    free(cdf);
+    free(thread_handles);
+    pthread_barrier_destroy(&barrier);
+    fclose(fp);
+
+    return 0;
+}
+
+/* Cumulative Zipf(skew) distribution over the bins */
+void Build_cdf(void) {
+    double sum = 0.0;
+
+    cdf = malloc(bins*sizeof(double));
+    for (int b = 0; b < bins; b++) {
+        sum += 1.0/pow(b + 1, skew);
+        cdf[b] = sum;
+    }
+    for (int b = 0; b < bins; b++)
+        cdf[b] /= sum;
+    cdf[bins - 1] = 1.0;
+}
+
+/* Smallest bin whose cdf is above a uniform draw */
+int Draw_bin(unsigned* seed) {
+    double u = my_drand(seed);
+    int lo = 0, hi = bins - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi)/2;
+        if (cdf[mid] > u) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+long long int Check_total(void) {
+    long long int total = 0;
+    for (int b = 0; b < bins; b++)
+        total += atomic_load(&global_hist[b]);
+    return total;
+}
+
+void* histogram(void* rank) {
+    long my_rank = (long) rank;
+    long long int my_samples = total_samples / thread_count;
+    long long int i;
+    unsigned seed = my_rank + 1;
+    int* keys = malloc(my_samples*sizeof(int));
+    long* mine = private_hist[my_rank];
+    int width = (approach == 2) ? hot_bins : bins;
+    int k, b;
+
+    for (i = 0; i < my_samples; i++)
+        keys[i] = Draw_bin(&seed);
+    for (b = 0; b < width; b++)
+        mine[b] = 0;
+
+    pthread_barrier_wait(&barrier);
+    if (my_rank == 0) GET_TIME(start);
+
+    if (approach == 0) {
+        for (i = 0; i < my_samples; i++)
+            atomic_fetch_add_explicit(&global_hist[keys[i]], 1,
+                                      memory_order_relaxed);
+    } else if (approach == 1) {
+        for (i = 0; i < my_samples; i++)
+            mine[keys[i]]++;
+    } else {
+        for (i = 0; i < my_samples; i++) {
+            k = keys[i];
+            if (k < hot_bins)
+                mine[k]++;
+            else
+                atomic_fetch_add_explicit(&global_hist[k], 1,
+                                          memory_order_relaxed);
+        }
+    }
+
+    if (approach != 0) {
+        Tree_reduce(my_rank, width);
+        if (my_rank == 0)
+            for (b = 0; b < width; b++)
+                atomic_fetch_add_explicit(&global_hist[b], mine[b],
+                                          memory_order_relaxed);
+    }
+
+    free(keys);
+    return NULL;
+}
+
+/* Sum the first width bins of the private histograms into thread 0's */
+void Tree_reduce(long my_rank, int width) {
+    long* mine = private_hist[my_rank];
+    long* partner;
+    int stride, b;
+
+    for (stride = 1; stride < thread_count; stride *= 2) {
+        pthread_barrier_wait(&barrier);
+        if (my_rank % (2*stride) == 0 && my_rank + stride < thread_count) {
+            partner = private_hist[my_rank + stride];
+            for (b = 0; b < width; b++)
+                mine[b] += partner[b];
+        }
+    }
+}
+
+void output_csv(FILE *fp, const char *algorithm, double elapsed_time) {
+    fprintf(fp, "%s,%lld,%d,%e\n", algorithm, total_samples,
+            thread_count, elapsed_time);
+}
+
+void Get_args(int argc, char* argv[]){
+   if (argc < 6 || argc > 7) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   total_samples = strtoll(argv[2], NULL, 10);
+   approach = strtol(argv[3], NULL, 10);
+   bins = strtol(argv[4], NULL, 10);
+   skew = strtod(argv[5], NULL);
+   if (argc == 7) hot_bins = strtol(argv[6], NULL, 10);
+   if (thread_count <= 0 || total_samples <= 0 || bins <= 0 || skew < 0 ||
+       hot_bins <= 0) Usage(argv[0]);
+   if (hot_bins > bins) hot_bins = bins;
+   if (approach < 0 || approach > 2) {
+      fprintf(stderr, "Error: Approach must be 0 for global atomics, 1 for private\n"
+                      "histograms or 2 for the hot/cold hybrid.\n");
+      exit(EXIT_FAILURE);
+   }
+}
+
+void Usage (char* program_name) {
+   fprintf(stderr, "Usage: %s <thread_count> <num_samples> <approach> <bins> <skew> [hot_bins]\n", program_name);
+   exit(0);
+}
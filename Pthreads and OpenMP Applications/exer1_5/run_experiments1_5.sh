@@ -3,7 +3,11 @@
 # Specify the range of inputs and threads to test
 iteration_values=(10000 100000 1000000 10000000 100000000)
 thread_values=(2 4)
-approaches=(0 1)
+approaches=(0 1 2 3 4 5 6 7 8 9 10 11)
+# Increments between counter reads (0 for no reads)
+read_frequencies=(0 1000)
+# Work inside and between critical sections, as "-c <cs> -n <ncs>"
+work_settings=("-c 0 -n 0" "-c 100 -n 0" "-c 100 -n 1000")
 
 # Specify the number of times to run the program for each input and thread count
 num_runs=5
@@ -12,9 +16,44 @@ num_runs=5
 for iterations in "${iteration_values[@]}"; do
     for approach in "${approaches[@]}"; do
         for thread_count in "${thread_values[@]}"; do
-            for ((i = 1; i <= num_runs; i++)); do
-                ./exercise1_5 $thread_count $iterations $approach
+            for read_every in "${read_frequencies[@]}"; do
+                for work in "${work_settings[@]}"; do
+                    # Work settings only apply to the mutex, atomic and lock zoo approaches
+                    if [[ "$work" != "-c 0 -n 0" && ( $approach -eq 2 || $approach -eq 3 ) ]]; then
+                        continue
+                    fi
+                    for ((i = 1; i <= num_runs; i++)); do
+                        ./exercise1_5 $work $thread_count $iterations $approach $read_every
+                    done
+                done
             done
         done
     done
-done
\ No newline at end of file
+done
+
+# Fixed-duration runs for throughput over time and per-thread fairness
+# (the iteration count is ignored with -d)
+duration=2
+for approach in "${approaches[@]}"; do
+    for thread_count in "${thread_values[@]}"; do
+        for ((i = 1; i <= num_runs; i++)); do
+            ./exercise1_5 -d $duration $thread_count 1 $approach
+        done
+    done
+done
+
+# Histogram kernel: strategy by bin count and skew
+hist_samples=10000000
+bin_values=(256 4096 65536)
+skew_values=(0 0.8 1.2)
+for bins in "${bin_values[@]}"; do
+    for skew in "${skew_values[@]}"; do
+        for approach in 0 1 2; do
+            for thread_count in "${thread_values[@]}"; do
+                for ((i = 1; i <= num_runs; i++)); do
+                    ./histogram1_5 $thread_count $hist_samples $approach $bins $skew
+                done
+            done
+        done
+    done
+done
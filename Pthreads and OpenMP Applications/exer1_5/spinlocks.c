@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <sched.h>
+#include "spinlocks.h"
+
+/* Spinning locks for the contention benchmarks.  Every wait loop pauses
+ * between polls and yields the CPU every SL_SPINS_PER_YIELD polls, so
+ * the queue locks still make progress when there are more threads than
+ * cores and the next owner has been preempted. */
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static inline void spin_wait(int* spins) {
+    if (++*spins % SL_SPINS_PER_YIELD == 0)
+        sched_yield();
+    else
+        cpu_relax();
+}
+
+/*-----------------------------------------------------------------*/
+void tas_init(tas_lock* lock) {
+    atomic_init(&lock->flag, 0);
+}
+
+void tas_acquire(tas_lock* lock) {
+    int spins = 0;
+
+    while (atomic_exchange_explicit(&lock->flag, 1, memory_order_acquire))
+        spin_wait(&spins);
+}
+
+void tas_release(tas_lock* lock) {
+    atomic_store_explicit(&lock->flag, 0, memory_order_release);
+}
+
+/*-----------------------------------------------------------------*/
+void ttas_init(ttas_lock* lock) {
+    atomic_init(&lock->flag, 0);
+}
+
+/* Poll with plain loads; after each lost exchange wait twice as long */
+void ttas_acquire(ttas_lock* lock) {
+    int backoff = SL_BACKOFF_MIN;
+    int spins = 0, i;
+
+    for (;;) {
+        while (atomic_load_explicit(&lock->flag, memory_order_relaxed))
+            spin_wait(&spins);
+        if (!atomic_exchange_explicit(&lock->flag, 1, memory_order_acquire))
+            return;
+        for (i = 0; i < backoff; i++)
+            cpu_relax();
+        if (backoff < SL_BACKOFF_MAX) backoff *= 2;
+    }
+}
+
+void ttas_release(ttas_lock* lock) {
+    atomic_store_explicit(&lock->flag, 0, memory_order_release);
+}
+
+/*-----------------------------------------------------------------*/
+void ticket_init(ticket_lock* lock) {
+    atomic_init(&lock->next, 0);
+    atomic_init(&lock->serving, 0);
+}
+
+void ticket_acquire(ticket_lock* lock) {
+    unsigned ticket = atomic_fetch_add_explicit(&lock->next, 1, memory_order_relaxed);
+    int spins = 0;
+
+    while (atomic_load_explicit(&lock->serving, memory_order_acquire) != ticket)
+        spin_wait(&spins);
+}
+
+void ticket_release(ticket_lock* lock) {
+    unsigned serving = atomic_load_explicit(&lock->serving, memory_order_relaxed);
+    atomic_store_explicit(&lock->serving, serving + 1, memory_order_release);
+}
+
+/*-----------------------------------------------------------------*/
+void mcs_init(mcs_lock* lock) {
+    atomic_init(&lock->tail, NULL);
+}
+
+void mcs_acquire(mcs_lock* lock, mcs_node* node) {
+    mcs_node* pred;
+    int spins = 0;
+
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+    pred = atomic_exchange_explicit(&lock->tail, node, memory_order_acq_rel);
+    if (pred == NULL) return;
+
+    atomic_store_explicit(&pred->next, node, memory_order_release);
+    while (atomic_load_explicit(&node->locked, memory_order_acquire))
+        spin_wait(&spins);
+}
+
+void mcs_release(mcs_lock* lock, mcs_node* node) {
+    mcs_node* succ = atomic_load_explicit(&node->next, memory_order_acquire);
+    mcs_node* expected = node;
+    int spins = 0;
+
+    if (succ == NULL) {
+        if (atomic_compare_exchange_strong_explicit(&lock->tail, &expected, NULL,
+                    memory_order_acq_rel, memory_order_relaxed))
+            return;
+        /* A successor is linking itself in */
+        while ((succ = atomic_load_explicit(&node->next, memory_order_acquire)) == NULL)
+            spin_wait(&spins);
+    }
+    atomic_store_explicit(&succ->locked, 0, memory_order_release);
+}
+
+/*-----------------------------------------------------------------*/
+clh_node* clh_new_node(void) {
+    clh_node* node = aligned_alloc(SL_CACHE_LINE, sizeof(clh_node));
+    atomic_init(&node->locked, 0);
+    return node;
+}
+
+void clh_init(clh_lock* lock) {
+    atomic_init(&lock->tail, clh_new_node());
+}
+
+void clh_destroy(clh_lock* lock) {
+    free(atomic_load(&lock->tail));
+}
+
+/* Returns the predecessor's node, which the caller uses for its next
+ * acquisition once it has released node */
+clh_node* clh_acquire(clh_lock* lock, clh_node* node) {
+    clh_node* pred;
+    int spins = 0;
+
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+    pred = atomic_exchange_explicit(&lock->tail, node, memory_order_acq_rel);
+    while (atomic_load_explicit(&pred->locked, memory_order_acquire))
+        spin_wait(&spins);
+    return pred;
+}
+
+void clh_release(clh_node* node) {
+    atomic_store_explicit(&node->locked, 0, memory_order_release);
+}
@@ -0,0 +1,69 @@
+#ifndef SPINLOCKS_H
+#define SPINLOCKS_H
+
+#include <stdatomic.h>
+
+#define SL_CACHE_LINE   64
+#define SL_BACKOFF_MIN  4       /* TTAS backoff, in pause instructions */
+#define SL_BACKOFF_MAX  1024
+#define SL_SPINS_PER_YIELD 64   /* spins before a waiter yields the CPU */
+
+/* Test-and-set */
+typedef struct {
+    atomic_int flag;
+} __attribute__((aligned(SL_CACHE_LINE))) tas_lock;
+
+/* Test-and-test-and-set with exponential backoff */
+typedef struct {
+    atomic_int flag;
+} __attribute__((aligned(SL_CACHE_LINE))) ttas_lock;
+
+/* Ticket lock: FIFO, all waiters spin on serving */
+typedef struct {
+    atomic_uint next;
+    atomic_uint serving;
+} __attribute__((aligned(SL_CACHE_LINE))) ticket_lock;
+
+/* MCS queue lock: each waiter spins on its own node */
+typedef struct mcs_node {
+    _Atomic(struct mcs_node*) next;
+    atomic_int locked;
+} __attribute__((aligned(SL_CACHE_LINE))) mcs_node;
+
+typedef struct {
+    _Atomic(mcs_node*) tail;
+} __attribute__((aligned(SL_CACHE_LINE))) mcs_lock;
+
+/* CLH queue lock: each waiter spins on its predecessor's node and
+ * takes that node over after releasing the lock */
+typedef struct {
+    atomic_int locked;
+} __attribute__((aligned(SL_CACHE_LINE))) clh_node;
+
+typedef struct {
+    _Atomic(clh_node*) tail;
+} __attribute__((aligned(SL_CACHE_LINE))) clh_lock;
+
+void tas_init(tas_lock* lock);
+void tas_acquire(tas_lock* lock);
+void tas_release(tas_lock* lock);
+
+void ttas_init(ttas_lock* lock);
+void ttas_acquire(ttas_lock* lock);
+void ttas_release(ttas_lock* lock);
+
+void ticket_init(ticket_lock* lock);
+void ticket_acquire(ticket_lock* lock);
+void ticket_release(ticket_lock* lock);
+
+void mcs_init(mcs_lock* lock);
+void mcs_acquire(mcs_lock* lock, mcs_node* node);
+void mcs_release(mcs_lock* lock, mcs_node* node);
+
+void clh_init(clh_lock* lock);
+void clh_destroy(clh_lock* lock);
+clh_node* clh_new_node(void);
+clh_node* clh_acquire(clh_lock* lock, clh_node* node);
+void clh_release(clh_node* node);
+
+#endif // SPINLOCKS_H
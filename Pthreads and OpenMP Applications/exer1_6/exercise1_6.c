@@ -5,42 +5,110 @@
  * 
  * Compile:  make all  (needs timer.h, my_rand.h and rwlocks.h)
  * 
- * Usage:    make run ARGS="<thread_count> <linear_system_size> <approach>"
+ * Usage:    make run ARGS="[-b block_size] [-c] [-k nrhs] [-f tile_file] [-w bandwidth] [-u rank] [-r rounds] [-m max_rank] <thread_count> <linear_system_size> <approach>"
  * 
  * Input:    Number of threads
  *           Size n of the linear system
- *           Approach type: 0 for serial or 1 for parallel
+ *           Approach type: 0 for serial, 1 for parallel, 2 for
+ *           blocked LU with partial pivoting or 3 for the same LU as a
+ *           task DAG in one parallel region, 4 for the blocked LU in
+ *           float with iterative refinement in double, 5 for the
+ *           blocked LU out of core, on column blocks kept in a file,
+ *           6 for a banded system solved in band storage, 7 for
+ *           solves after repeated low-rank updates of A
+ *           -b: panel width of the blocked LU and block size of the
+ *           parallel back substitution (default 64)
+ *           -c: check the solution against a copy of A and b
+ *           -k: right-hand sides solved with one LU factorisation
+ *           (approaches 2 and 3; the first is b, the rest random)
+ *           -f: file for the out-of-core matrix (default A1_6.tiles);
+ *           the factors go to the same name with .lu appended, and
+ *           both files are removed at the end
+ *           -w: sub- and superdiagonals of the banded system (default 16)
+ *           -u: rows of A replaced by each low-rank update (default 1)
+ *           -r: low-rank updates applied (default 10)
+ *           -m: update rank collected before A is factored again
+ *           (default 64)
  * 
  * Output:   The matrixes A, b and x
  * 			 Elapsed time to carry out the calculation of the Gaussian elimination and back substitution
+ *           For the blocked LU also the GFLOP/s of the factorisation
+ *           and, with -k, the solve time per right-hand side
+ *           For the task LU also the average and peak number of tasks
+ *           running at once; every task is appended to Trace1_6.csv
+ *           For the mixed precision LU the refinement steps, the final
+ *           residual and the speedup over approach 2 on the same system
+ *           For the out-of-core LU the bytes read and written, the time
+ *           the I/O thread was busy, the time spent waiting for it and
+ *           the share of the I/O hidden behind computation
+ *           For the banded solver the GFLOP/s of the factorisation; with
+ *           -c and n <= BAND_CHECK_MAX also the largest difference from
+ *           the dense blocked LU solution
+ *           For the low-rank updates the average update and solve time
+ *           against factoring and solving the updated A from scratch,
+ *           the number of refactorisations and the largest difference
+ *           between the two solutions
+ *           With -c the relative residual ||Ax-b|| / (||A|| ||x|| + ||b||)
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <omp.h>
 #include "../timer.h"
+#include "lu.h"
+
+/* Largest banded system -c also solves with the dense LU */
+#define BAND_CHECK_MAX 2000
 
 /*Global variables*/
 int thread_count, n, approach;
+int block_size = LU_DEFAULT_BLOCK, check = 0, nrhs = 1;
+char* tile_file = "A1_6.tiles";
+int bandwidth = 16;
+int update_rank = 1, rounds = 10, max_rank = 64;
 
 /*Serial functions*/
 void Usage(char *prog_name);
 void Gen_matrix(double A[]);
 void Gen_vector(double b[]);
+void Gen_matrix_file(char* path);
+void Gen_banded_matrix(double AB[]);
+double Residual_band(double AB[], double b[], double x[]);
+void Compare_dense(double AB[], double b[], double x[]);
+double Residual_file(char* path, double b[], double x[]);
+void Report_ooc(char* what, lu_ooc_stats* stats);
 void Get_args(int argc, char *argv[]);
 void Print_matrix(double A[]);
 void Print_vector(double y[]);
 double Gauss_elim_serial(double A[], double b[]);
 double Back_sub_serial(double A[], double b[], double x[]);
 void output_csv(FILE *fp, char* functionality, double elapsed_time);
+double Residual(double A[], double b[], double x[]);
+void Report_trace(lu_trace* trace, double elapsed);
 
 /*Parallel functions*/
 double Gauss_elim_parallel(double A[], double b[]);
 double Back_sub_parallel(double A[], double b[], double x[]);
+double LU_factor_blocked(double A[], int piv[]);
+double LU_factor_tasks(double A[], int piv[], lu_trace* trace);
+double LU_solve(double A[], int piv[], double b[], double x[]);
+double LU_solve_many(double A[], int piv[], double b[], double x[]);
+double LU_solve_mixed(double A[], double b[], double x[]);
+double LU_ooc(int piv[], double b[], double x[]);
+double LU_band(double AB[], int piv[], double b[], double x[]);
+double LU_low_rank(FILE* fp, double A[], double b[], double x[]);
 
 int main(int argc, char* argv[]) {
     double elapsed_Gauss, elapsed_back;
     double *A, *b, *x;
+    size_t a_size;
+    double *A0 = NULL, *b0 = NULL, *x_double;
+    int *piv;
+    lu_trace trace;
 
     Get_args(argc, argv);
     FILE *fp = fopen("Results1_6.csv", "a");
@@ -50,11 +118,31 @@ int main(int argc, char* argv[]) {
     }
     /*csv records: n, approach, thread_count, functionality, elapsed_time*/
     
-    A = malloc(n*n*sizeof(double));
+    a_size = (approach == 6) ? (size_t)n*LU_BAND_LD(bandwidth, bandwidth)
+                             : (size_t)n*n;
     b = malloc(n*sizeof(double));
     x = malloc(n*sizeof(double));   
-    Gen_matrix(A);
+    if (approach == 5) {
+        /* Only the file ever holds all of A */
+        A = NULL;
+        Gen_matrix_file(tile_file);
+    } else if (approach == 6) {
+        A = malloc(a_size*sizeof(double));
+        Gen_banded_matrix(A);
+    } else {
+        A = malloc(n*n*sizeof(double));
+        Gen_matrix(A);
+    }
     Gen_vector(b);
+    /* Approach 7 checks against the updated A itself */
+    if (check && approach != 5 && approach != 7) {
+        A0 = malloc(a_size*sizeof(double));
+        memcpy(A0, A, a_size*sizeof(double));
+    }
+    if (check && approach != 5) {
+        b0 = malloc(n*sizeof(double));
+        memcpy(b0, b, n*sizeof(double));
+    }
     #ifdef DEBUG
         printf("Matrix A: \n");
         Print_matrix(A);
@@ -78,6 +166,62 @@ int main(int argc, char* argv[]) {
         #endif  
 
     }
+    else if (approach == 2 || approach == 3) {
+        piv = malloc(n*sizeof(int));
+        if (approach == 2) {
+            elapsed_Gauss = LU_factor_blocked(A, piv);
+            output_csv(fp, "LU factorisation", elapsed_Gauss);
+        } else {
+            lu_trace_init(&trace, n, block_size);
+            elapsed_Gauss = LU_factor_tasks(A, piv, &trace);
+            output_csv(fp, "Task LU factorisation", elapsed_Gauss);
+            Report_trace(&trace, elapsed_Gauss);
+            lu_trace_free(&trace);
+        }
+        printf("LU factorisation: %e seconds, %.2f GFLOP/s\n", elapsed_Gauss,
+               lu_flops(n)/elapsed_Gauss/1e9);
+        if (nrhs == 1) {
+            elapsed_back = LU_solve(A, piv, b, x);
+            output_csv(fp, "LU solve", elapsed_back);
+            printf("LU solve: %e seconds\n", elapsed_back);
+        } else {
+            elapsed_back = LU_solve_many(A, piv, b, x);
+            output_csv(fp, "LU solve per RHS", elapsed_back/nrhs);
+            printf("LU solve of %d right-hand sides: %e seconds, %e per RHS\n",
+                   nrhs, elapsed_back, elapsed_back/nrhs);
+        }
+        free(piv);
+    }
+    else if (approach == 4) {
+        elapsed_Gauss = LU_solve_mixed(A, b, x);
+        output_csv(fp, "Mixed LU solve", elapsed_Gauss);
+
+        /* The double path on the same system, for the speedup */
+        piv = malloc(n*sizeof(int));
+        elapsed_back = LU_factor_blocked(A, piv);
+        x_double = malloc(n*sizeof(double));
+        elapsed_back += LU_solve(A, piv, b, x_double);
+        output_csv(fp, "Double LU solve", elapsed_back);
+        printf("Double LU solve: %e seconds, speedup of mixed precision %.2f\n",
+               elapsed_back, elapsed_back/elapsed_Gauss);
+        free(x_double);
+        free(piv);
+    }
+    else if (approach == 5) {
+        piv = malloc(n*sizeof(int));
+        elapsed_Gauss = LU_ooc(piv, b, x);
+        output_csv(fp, "Out-of-core LU solve", elapsed_Gauss);
+        free(piv);
+    }
+    else if (approach == 6) {
+        piv = malloc(n*sizeof(int));
+        elapsed_Gauss = LU_band(A, piv, b, x);
+        output_csv(fp, "Band LU solve", elapsed_Gauss);
+        free(piv);
+    }
+    else if (approach == 7) {
+        LU_low_rank(fp, A, b, x);
+    }
     else {       
         elapsed_Gauss=Gauss_elim_parallel(A, b);
         output_csv(fp, "Gauss elimination", elapsed_Gauss);
@@ -93,6 +237,30 @@ int main(int argc, char* argv[]) {
         
     }
 
+    if (check && approach == 5) {
+        printf("Relative residual: %e\n", Residual_file(tile_file, b, x));
+    } else if (check && approach == 6) {
+        printf("Relative residual: %e\n", Residual_band(A0, b0, x));
+        if (n <= BAND_CHECK_MAX) Compare_dense(A0, b0, x);
+        free(A0);
+        free(b0);
+    } else if (check && approach == 7) {
+        /* A itself has been updated */
+        printf("Relative residual: %e\n", Residual(A, b0, x));
+        free(b0);
+    } else if (check) {
+        printf("Relative residual: %e\n", Residual(A0, b0, x));
+        free(A0);
+        free(b0);
+    }
+
+    if (approach == 5) {
+        char lu_file[strlen(tile_file) + 4];
+        sprintf(lu_file, "%s.lu", tile_file);
+        unlink(tile_file);
+        unlink(lu_file);
+    }
+
 	fclose(fp);
     free(A);
     free(b);
@@ -119,6 +287,60 @@ void Gen_vector(double b[]) {
       b[i] = (double) random();
 }
 
+/* Random entries within bandwidth of the diagonal, a nonzero */
+/* diagonal, and zeros in the rest of the band storage        */
+void Gen_banded_matrix(double AB[]) {
+    int i, j, temp, kl = bandwidth, ld = LU_BAND_LD(bandwidth, bandwidth);
+
+    memset(AB, 0, (size_t)n*ld*sizeof(double));
+    for (i = 0; i < n; i++) {
+        for (j = (i > kl ? i-kl : 0); j <= i+kl && j < n; j++) {
+            temp=random();
+            while((temp==0)&&(i==j))
+                temp=random();
+            AB[(size_t)i*ld + j-i+kl] = (double) temp;
+        }
+    }
+}
+
+/* Gen_matrix's matrix, written nb rows at a time into the column */
+/* block file used by the out-of-core LU                           */
+void Gen_matrix_file(char* path) {
+    int i0, rows, i, j, c, w, temp;
+    double *chunk = malloc((size_t)block_size*n*sizeof(double));
+    double *packed = malloc((size_t)block_size*block_size*sizeof(double));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        perror("Error opening tile file");
+        exit(EXIT_FAILURE);
+    }
+    for (i0 = 0; i0 < n; i0 += block_size) {
+        rows = (n - i0 < block_size) ? n - i0 : block_size;
+        for (i = 0; i < rows; i++)
+            for (j = 0; j < n; j++) {
+                temp=random();
+                while((temp==0)&&(i0+i==j))
+                    temp=random();
+                chunk[(size_t)i*n+j] = (double) temp;
+            }
+        for (j = 0; j*block_size < n; j++) {
+            w = lu_ooc_width(n, block_size, j);
+            for (i = 0; i < rows; i++)
+                for (c = 0; c < w; c++)
+                    packed[i*w+c] = chunk[(size_t)i*n + j*block_size + c];
+            if (pwrite(fd, packed, (size_t)rows*w*sizeof(double),
+                       lu_ooc_offset(n, block_size, j) + (off_t)i0*w*sizeof(double)) < 0) {
+                perror("Error writing tile file");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    close(fd);
+    free(chunk);
+    free(packed);
+}
+
 double Gauss_elim_serial(double A[], double b[]) {
     int i, j, k;
     double start, finish, ratio;
@@ -175,26 +397,403 @@ double Gauss_elim_parallel(double A[], double b[]) {
     return finish-start;
 }
 
+/* Blocked: one thread solves each diagonal block, then the team   */
+/* updates the rows above it, all in one parallel region            */
 double Back_sub_parallel(double A[], double b[], double x[]) {
-    int  row, col;
-    double start, finish, temp;
+    double start, finish;
     GET_TIME(start);
 
     /*Back substitution*/
-    for (row = n-1; row >= 0; row--) {
-        x[row] = b[row];
-        temp=x[row];
-#       pragma omp parallel for num_threads(thread_count) \
-		    default(none) reduction(-: temp) private(col) shared(A, x, n, row)
-        for (col = row+1; col < n; col++)
-            temp -= A[row*n+col]*x[col];
-        x[row]= temp / A[row*n+row];
+    memcpy(x, b, n*sizeof(double));
+    lu_back_sub(A, n, x, block_size, thread_count);
+
+    GET_TIME(finish);
+    return finish-start;
+}
+
+double LU_factor_blocked(double A[], int piv[]) {
+    double start, finish;
+    int info;
+    GET_TIME(start);
+
+    info = lu_factor(A, n, piv, block_size, thread_count);
+
+    GET_TIME(finish);
+    if (info != 0)
+        fprintf(stderr, "Warning: U(%d,%d) is zero, the matrix is singular\n",
+                info-1, info-1);
+    return finish-start;
+}
+
+double LU_solve(double A[], int piv[], double b[], double x[]) {
+    double start, finish;
+    GET_TIME(start);
+
+    memcpy(x, b, n*sizeof(double));
+    lu_solve(A, piv, n, x, block_size, thread_count);
+
+    GET_TIME(finish);
+    return finish-start;
+}
+
+double LU_factor_tasks(double A[], int piv[], lu_trace* trace) {
+    double start, finish;
+    int info;
+    GET_TIME(start);
+
+    info = lu_factor_tasks(A, n, piv, block_size, thread_count, trace);
+
+    GET_TIME(finish);
+    if (info != 0)
+        fprintf(stderr, "Warning: U(%d,%d) is zero, the matrix is singular\n",
+                info-1, info-1);
+    return finish-start;
+}
+
+static int Compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/* Achieved task parallelism: busy time over elapsed time, and the most
+ * tasks running at once from a sweep over the sorted start and end
+ * times */
+void Report_trace(lu_trace* trace, double elapsed) {
+    int i, j, count = trace->count, running = 0, peak = 0;
+    double busy = 0.0, *starts, *ends;
+    const char* kinds[] = { "panel", "update", "swap" };
+    lu_task_event* e;
+    FILE* fp = fopen("Trace1_6.csv", "a");
+
+    /*csv records: n, thread_count, task, step, column_block, thread, start, end*/
+    starts = malloc(count*sizeof(double));
+    ends = malloc(count*sizeof(double));
+    for (i = 0; i < count; i++) {
+        e = &trace->events[i];
+        busy += e->end - e->start;
+        starts[i] = e->start;
+        ends[i] = e->end;
+        if (fp != NULL)
+            fprintf(fp, "%d,%d,%s,%d,%d,%d,%e,%e\n", n, thread_count,
+                    kinds[e->kind], e->step, e->col, e->thread, e->start, e->end);
+    }
+    if (fp != NULL) fclose(fp);
+
+    qsort(starts, count, sizeof(double), Compare_doubles);
+    qsort(ends, count, sizeof(double), Compare_doubles);
+    for (i = 0, j = 0; i < count; ) {
+        if (starts[i] < ends[j]) {
+            if (++running > peak) peak = running;
+            i++;
+        } else {
+            running--;
+            j++;
+        }
+    }
+    free(starts);
+    free(ends);
+
+    printf("Tasks: %d, average parallelism %.2f, peak %d\n", count,
+           busy/elapsed, peak);
+}
+
+/* Solve for b and nrhs-1 random right-hand sides at once; x gets */
+/* the solution for b                                               */
+double LU_solve_many(double A[], int piv[], double b[], double x[]) {
+    int i, j;
+    double start, finish;
+    double* B = malloc((size_t)n*nrhs*sizeof(double));
+
+    for (i = 0; i < n; i++) {
+        B[i*nrhs] = b[i];
+        for (j = 1; j < nrhs; j++)
+            B[i*nrhs+j] = (double) random();
+    }
+    GET_TIME(start);
+
+    lu_solve_many(A, piv, n, B, nrhs, block_size, thread_count);
+
+    GET_TIME(finish);
+    for (i = 0; i < n; i++)
+        x[i] = B[i*nrhs];
+    free(B);
+    return finish-start;
+}
+
+double LU_solve_mixed(double A[], double b[], double x[]) {
+    double start, finish;
+    lu_mixed_stats stats;
+    GET_TIME(start);
+
+    lu_solve_mixed(A, n, b, x, block_size, thread_count, &stats);
+
+    GET_TIME(finish);
+    printf("Mixed LU solve: %e seconds (float factorisation %e, refinement %e",
+           finish-start, stats.factor_time, stats.refine_time);
+    if (stats.fell_back)
+        printf(", double fallback %e", stats.fallback_time);
+    printf(")\n");
+    printf("Refinement steps: %d%s, residual %e\n", stats.iterations,
+           stats.fell_back ? " (stalled)" : "", stats.residual);
+    return finish-start;
+}
+
+double LU_ooc(int piv[], double b[], double x[]) {
+    double start, finish;
+    lu_ooc_stats stats;
+    char lu_file[strlen(tile_file) + 4];
+    int info;
+
+    sprintf(lu_file, "%s.lu", tile_file);
+    GET_TIME(start);
+
+    info = lu_ooc_factor(tile_file, lu_file, n, block_size, piv, thread_count,
+                         &stats);
+    if (info < 0) {
+        perror("Error in out-of-core LU factorisation");
+        unlink(tile_file);
+        unlink(lu_file);
+        exit(EXIT_FAILURE);
     }
+    Report_ooc("Out-of-core LU factorisation", &stats);
+    memcpy(x, b, n*sizeof(double));
+    if (lu_ooc_solve(lu_file, n, block_size, piv, x, &stats) != 0) {
+        perror("Error in out-of-core LU solve");
+        unlink(tile_file);
+        unlink(lu_file);
+        exit(EXIT_FAILURE);
+    }
+    Report_ooc("Out-of-core LU solve", &stats);
+
+    GET_TIME(finish);
+    if (info != 0)
+        fprintf(stderr, "Warning: U(%d,%d) is zero, the matrix is singular\n",
+                info-1, info-1);
+    return finish-start;
+}
+
+double LU_band(double AB[], int piv[], double b[], double x[]) {
+    double start, finish, factor;
+    int info;
+    GET_TIME(start);
+
+    info = lu_band_factor(AB, n, bandwidth, bandwidth, piv, thread_count);
+    GET_TIME(factor);
+    memcpy(x, b, n*sizeof(double));
+    lu_band_solve(AB, n, bandwidth, bandwidth, piv, x);
 
     GET_TIME(finish);
+    if (info != 0)
+        fprintf(stderr, "Warning: U(%d,%d) is zero, the matrix is singular\n",
+                info-1, info-1);
+    printf("Band LU factorisation: %e seconds, %.2f GFLOP/s, solve %e seconds\n",
+           factor-start, lu_band_flops(n, bandwidth, bandwidth)/(factor-start)/1e9,
+           finish-factor);
     return finish-start;
 }
 
+/* Each round replaces update_rank random rows of A, i.e. adds U V^T */
+/* with unit vectors in U and the row changes in V, then solves the  */
+/* updated system both through lu_upd_update and by factoring A      */
+/* again.  A ends up as the last updated matrix, x as its solution.  */
+double LU_low_rank(FILE* fp, double A[], double b[], double x[]) {
+    double start, finish, t_update = 0.0, t_full = 0.0, diff, diff_max = 0.0;
+    double x_max;
+    int k = update_rank, round, r, row, j, refactored = 0;
+    double *U = malloc((size_t)n*k*sizeof(double));
+    double *V = malloc((size_t)n*k*sizeof(double));
+    double *LU = malloc((size_t)n*n*sizeof(double));
+    double *x_full = malloc(n*sizeof(double));
+    int *piv = malloc(n*sizeof(int));
+    lu_updatable f;
+
+    GET_TIME(start);
+    if (lu_upd_init(&f, A, n, block_size, max_rank, thread_count) != 0)
+        fprintf(stderr, "Warning: the matrix is singular\n");
+    GET_TIME(finish);
+    output_csv(fp, "LU factorisation", finish-start);
+
+    for (round = 0; round < rounds; round++) {
+        memset(U, 0, (size_t)n*k*sizeof(double));
+        for (r = 0; r < k; r++) {
+            row = random() % n;
+            U[(size_t)row*k+r] = 1.0;
+            for (j = 0; j < n; j++) {
+                double value = (double) random();
+                V[(size_t)j*k+r] = value - A[(size_t)row*n+j];
+                A[(size_t)row*n+j] = value;
+            }
+        }
+
+        GET_TIME(start);
+        refactored += lu_upd_update(&f, U, V, k);
+        memcpy(x, b, n*sizeof(double));
+        lu_upd_solve(&f, x);
+        GET_TIME(finish);
+        t_update += finish-start;
+        output_csv(fp, "Low-rank update solve", finish-start);
+
+        GET_TIME(start);
+        memcpy(LU, A, (size_t)n*n*sizeof(double));
+        lu_factor(LU, n, piv, block_size, thread_count);
+        memcpy(x_full, b, n*sizeof(double));
+        lu_solve(LU, piv, n, x_full, block_size, thread_count);
+        GET_TIME(finish);
+        t_full += finish-start;
+        output_csv(fp, "Full LU solve", finish-start);
+
+        x_max = 0.0;
+        diff = 0.0;
+        for (j = 0; j < n; j++) {
+            if (fabs(x[j]-x_full[j]) > diff) diff = fabs(x[j]-x_full[j]);
+            if (fabs(x_full[j]) > x_max) x_max = fabs(x_full[j]);
+        }
+        if (diff/x_max > diff_max) diff_max = diff/x_max;
+    }
+
+    printf("Rank %d updates: %e seconds per update and solve, full LU solve "
+           "%e, speedup %.2f\n", k, t_update/rounds, t_full/rounds,
+           t_full/t_update);
+    printf("Refactorisations: %d of %d updates, largest relative difference "
+           "%e\n", refactored, rounds, diff_max);
+
+    lu_upd_free(&f);
+    free(U);
+    free(V);
+    free(LU);
+    free(x_full);
+    free(piv);
+    return t_update;
+}
+
+/* Residual of the banded system from its band storage */
+double Residual_band(double AB[], double b[], double x[]) {
+    int i, j, kl = bandwidth, ld = LU_BAND_LD(bandwidth, bandwidth);
+    double r, a, row_sum, r_max = 0.0, a_max = 0.0, x_max = 0.0, b_max = 0.0;
+
+    for (i = 0; i < n; i++) {
+        r = -b[i];
+        row_sum = 0.0;
+        for (j = (i > kl ? i-kl : 0); j <= i+kl && j < n; j++) {
+            a = AB[(size_t)i*ld + j-i+kl];
+            r += a*x[j];
+            row_sum += fabs(a);
+        }
+        if (fabs(r) > r_max) r_max = fabs(r);
+        if (row_sum > a_max) a_max = row_sum;
+        if (fabs(x[i]) > x_max) x_max = fabs(x[i]);
+        if (fabs(b[i]) > b_max) b_max = fabs(b[i]);
+    }
+    return r_max / (a_max*x_max + b_max);
+}
+
+/* Solve the banded system again as a dense one with the blocked LU */
+void Compare_dense(double AB[], double b[], double x[]) {
+    int i, j, kl = bandwidth, ld = LU_BAND_LD(bandwidth, bandwidth);
+    double *A = calloc((size_t)n*n, sizeof(double));
+    double *y = malloc(n*sizeof(double));
+    int *piv = malloc(n*sizeof(int));
+    double diff = 0.0, x_max = 0.0;
+
+    for (i = 0; i < n; i++)
+        for (j = (i > kl ? i-kl : 0); j <= i+kl && j < n; j++)
+            A[(size_t)i*n+j] = AB[(size_t)i*ld + j-i+kl];
+    lu_factor(A, n, piv, block_size, thread_count);
+    memcpy(y, b, n*sizeof(double));
+    lu_solve(A, piv, n, y, block_size, thread_count);
+    for (i = 0; i < n; i++) {
+        if (fabs(x[i] - y[i]) > diff) diff = fabs(x[i] - y[i]);
+        if (fabs(y[i]) > x_max) x_max = fabs(y[i]);
+    }
+    printf("Relative difference from the dense solver: %e\n", diff/x_max);
+    free(A);
+    free(y);
+    free(piv);
+}
+
+/* I/O volume and how much of the I/O time the computation hid */
+void Report_ooc(char* what, lu_ooc_stats* stats) {
+    double hidden = stats->io_time > 0
+                    ? 1.0 - stats->stall_time/stats->io_time : 1.0;
+
+    if (hidden < 0) hidden = 0;
+    printf("%s: %e seconds, read %.1f MB, wrote %.1f MB\n", what,
+           stats->total_time, stats->bytes_read/1e6, stats->bytes_written/1e6);
+    printf("   I/O busy %e s, compute waited %e s, %.0f%% of I/O overlapped\n",
+           stats->io_time, stats->stall_time, 100*hidden);
+}
+
+/* Residual of the out-of-core system, reading A one block at a time */
+double Residual_file(char* path, double b[], double x[]) {
+    int i, j, c, w, fd = open(path, O_RDONLY);
+    double *X = malloc((size_t)n*block_size*sizeof(double));
+    double *r = malloc(n*sizeof(double));
+    double *row_sum = calloc(n, sizeof(double));
+    double r_max = 0.0, a_max = 0.0, x_max = 0.0, b_max = 0.0;
+    size_t done, bytes;
+    ssize_t got;
+
+    if (fd < 0) {
+        perror("Error opening tile file");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < n; i++)
+        r[i] = -b[i];
+    for (j = 0; j*block_size < n; j++) {
+        w = lu_ooc_width(n, block_size, j);
+        bytes = (size_t)n*w*sizeof(double);
+        for (done = 0; done < bytes; done += got) {
+            got = pread(fd, (char*) X + done, bytes - done,
+                        lu_ooc_offset(n, block_size, j) + done);
+            if (got < 0 && errno == EINTR) {
+                got = 0;
+                continue;
+            }
+            if (got <= 0) {
+                if (got == 0) errno = EIO;
+                perror("Error reading tile file");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (i = 0; i < n; i++)
+            for (c = 0; c < w; c++) {
+                r[i] += X[(size_t)i*w+c]*x[j*block_size+c];
+                row_sum[i] += fabs(X[(size_t)i*w+c]);
+            }
+    }
+    for (i = 0; i < n; i++) {
+        if (fabs(r[i]) > r_max) r_max = fabs(r[i]);
+        if (row_sum[i] > a_max) a_max = row_sum[i];
+        if (fabs(x[i]) > x_max) x_max = fabs(x[i]);
+        if (fabs(b[i]) > b_max) b_max = fabs(b[i]);
+    }
+    close(fd);
+    free(X);
+    free(r);
+    free(row_sum);
+    return r_max / (a_max*x_max + b_max);
+}
+
+/* ||Ax-b||_inf / (||A||_inf ||x||_inf + ||b||_inf) on the original A, b */
+double Residual(double A[], double b[], double x[]) {
+    int i, j;
+    double r, row_sum, r_max = 0.0, a_max = 0.0, x_max = 0.0, b_max = 0.0;
+
+    for (i = 0; i < n; i++) {
+        r = -b[i];
+        row_sum = 0.0;
+        for (j = 0; j < n; j++) {
+            r += A[i*n+j]*x[j];
+            row_sum += fabs(A[i*n+j]);
+        }
+        if (fabs(r) > r_max) r_max = fabs(r);
+        if (row_sum > a_max) a_max = row_sum;
+        if (fabs(x[i]) > x_max) x_max = fabs(x[i]);
+        if (fabs(b[i]) > b_max) b_max = fabs(b[i]);
+    }
+    return r_max / (a_max*x_max + b_max);
+}
+
 void Print_matrix(double A[]) {
    int   i, j;
    for (i = 0; i < n; i++) {
@@ -216,14 +815,35 @@ void output_csv(FILE *fp, char* functionality, double elapsed_time){
 }
 
 void Get_args(int argc, char* argv[]) {
+    int opt;
+    char* program_name = argv[0];
+
+    while ((opt = getopt(argc, argv, "b:ck:f:w:u:r:m:")) != -1) {
+        switch (opt) {
+            case 'b': block_size = strtol(optarg, NULL, 10); break;
+            case 'c': check = 1; break;
+            case 'k': nrhs = strtol(optarg, NULL, 10); break;
+            case 'f': tile_file = optarg; break;
+            case 'w': bandwidth = strtol(optarg, NULL, 10); break;
+            case 'u': update_rank = strtol(optarg, NULL, 10); break;
+            case 'r': rounds = strtol(optarg, NULL, 10); break;
+            case 'm': max_rank = strtol(optarg, NULL, 10); break;
+            default: Usage(program_name);
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
     if (argc != 4) {
-        Usage(argv[0]);
+        Usage(program_name);
     }
     thread_count = strtol(argv[1], NULL, 10);
     n = strtol(argv[2], NULL, 10);
     approach = strtol(argv[3], NULL, 10);
-    if (thread_count <= 0 || n <= 0 || (approach != 0 && approach != 1)) {
-        Usage(argv[0]);
+    if (thread_count <= 0 || n <= 0 || approach < 0 || approach > 7 ||
+        block_size <= 0 || nrhs <= 0 || bandwidth < 0 ||
+        update_rank <= 0 || rounds <= 0 || max_rank <= 0) {
+        Usage(program_name);
     }
     if (approach == 0 && thread_count != 1) {
         fprintf(stderr, "Error: If Serial approach is chosen, there must be only one thread.\n");
@@ -232,10 +852,22 @@ void Get_args(int argc, char* argv[]) {
 }
 
 void Usage(char* program_name) {
-    fprintf(stderr, "Usage: %s <thread_count> <linear_system_size> <approach>\n"
-                    "       0 for Serial, 1 for Parallel\n"
+    fprintf(stderr, "Usage: %s [-b block_size] [-c] [-k nrhs] [-f tile_file] [-w bandwidth]\n"
+                    "       [-u rank] [-r rounds] [-m max_rank]\n"
+                    "       <thread_count> <linear_system_size> <approach>\n"
+                    "       0 for Serial, 1 for Parallel, 2 for Blocked LU, 3 for Task LU,\n"
+                    "       4 for Mixed precision LU, 5 for Out-of-core LU, 6 for Band LU,\n"
+                    "       7 for Low-rank updates\n"
                     "       <thread_count> must be positive\n"
                     "       <linear_system_size> must be positive\n"
-                    "       <approach> must be either 0 or 1\n", program_name);
+                    "       <approach> must be between 0 and 7\n"
+                    "       -b sets the blocked LU panel width and back substitution block\n"
+                    "       -c checks the residual of the solution\n"
+                    "       -k solves that many right-hand sides with one factorisation\n"
+                    "       -f names the out-of-core matrix file\n"
+                    "       -w sets the sub- and superdiagonals of the banded system\n"
+                    "       -u sets the rows replaced by each low-rank update\n"
+                    "       -r sets the number of low-rank updates\n"
+                    "       -m sets the update rank collected before refactoring\n", program_name);
     exit(EXIT_FAILURE);
 }
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "lu.h"
+#include "lu_kernels.h"
+
+/* Most right-hand sides a thread takes at once in lu_solve_many */
+#define RHS_COLS 16
+
+void lu_trace_init(lu_trace* trace, int n, int nb) {
+    int blocks = (n + nb - 1)/nb;
+
+    trace->capacity = blocks + blocks*(blocks-1)/2 + blocks;
+    trace->events = malloc(trace->capacity*sizeof(lu_task_event));
+    trace->count = 0;
+}
+
+void lu_trace_free(lu_trace* trace) {
+    free(trace->events);
+    trace->events = NULL;
+}
+
+static void trace_task(lu_trace* trace, lu_task_kind kind, int step, int col,
+                       double start, double end) {
+    int slot;
+
+    if (trace == NULL) return;
+#   pragma omp atomic capture
+    slot = trace->count++;
+    if (slot >= trace->capacity) return;
+    trace->events[slot].kind = kind;
+    trace->events[slot].step = step;
+    trace->events[slot].col = col;
+    trace->events[slot].thread = omp_get_thread_num();
+    trace->events[slot].start = start - trace->origin;
+    trace->events[slot].end = end - trace->origin;
+}
+
+int lu_factor_tasks(double A[], int n, int piv[], int nb, int thread_count,
+                    lu_trace* trace) {
+    int blocks = (n + nb - 1)/nb;
+    int info = 0;
+    /* Dependence tokens, one per column block */
+    char* col = malloc(blocks);
+
+    if (trace != NULL) {
+        trace->count = 0;
+        trace->origin = omp_get_wtime();
+    }
+
+#   pragma omp parallel num_threads(thread_count) \
+        default(none) shared(A, n, piv, nb, blocks, info, col, trace)
+#   pragma omp single
+    {
+        int k, j;
+
+        for (k = 0; k < blocks; k++) {
+#           pragma omp task depend(inout: col[k]) priority(1)
+            {
+                double t0 = omp_get_wtime();
+                int k0 = k*nb, kb = min(nb, n - k0);
+                int step_info = panel_factor(A, n, k0, kb, piv);
+
+                if (step_info != 0) {
+#                   pragma omp critical
+                    if (info == 0 || step_info < info) info = step_info;
+                }
+                trace_task(trace, LU_TASK_PANEL, k, k, t0, omp_get_wtime());
+            }
+
+            for (j = k+1; j < blocks; j++) {
+                /* The next panel's column block is on the critical path;
+                 * the priorities only count with OMP_MAX_TASK_PRIORITY >= 1 */
+#               pragma omp task depend(in: col[k]) depend(inout: col[j]) \
+                    priority(j == k+1)
+                {
+                    double t0 = omp_get_wtime();
+                    int k0 = k*nb, kb = min(nb, n - k0), end = k0 + kb;
+                    int c0 = j*nb, c1 = min(c0 + nb, n), r;
+
+                    swap_rows(A, n, piv, k0, kb, c0, c1);
+                    trsm_unit_lower(A, n, k0, kb, c0, c1);
+                    for (r = end; r < n; r += GEMM_ROWS)
+                        gemm_update(A, n, k0, kb, r, min(r+GEMM_ROWS, n), c0, c1);
+                    trace_task(trace, LU_TASK_UPDATE, k, j, t0, omp_get_wtime());
+                }
+            }
+        }
+
+        /* Column block j still needs the swaps of every later step */
+        for (j = 0; j < blocks-1; j++) {
+#           pragma omp task depend(inout: col[j]) depend(in: col[blocks-1])
+            {
+                double t0 = omp_get_wtime();
+                int c0 = j*nb, c1 = c0 + nb, s;
+
+                for (s = j+1; s < blocks; s++)
+                    swap_rows(A, n, piv, s*nb, min(nb, n - s*nb), c0, c1);
+                trace_task(trace, LU_TASK_SWAP, blocks-1, j, t0, omp_get_wtime());
+            }
+        }
+    }
+
+    free(col);
+    return info;
+}
+
+void lu_forward_sub(const double LU[], int n, double x[], int nb,
+                    int thread_count) {
+#   pragma omp parallel num_threads(thread_count) \
+        default(none) shared(LU, n, x, nb)
+    {
+        int r0, r1, i, j;
+        double sum;
+
+        for (r0 = 0; r0 < n; r0 += nb) {
+            r1 = min(r0 + nb, n);
+#           pragma omp single
+            for (i = r0+1; i < r1; i++) {
+                sum = x[i];
+                for (j = r0; j < i; j++)
+                    sum -= LU[i*n+j]*x[j];
+                x[i] = sum;
+            }
+
+#           pragma omp for schedule(static)
+            for (i = r1; i < n; i++) {
+                sum = x[i];
+                for (j = r0; j < r1; j++)
+                    sum -= LU[i*n+j]*x[j];
+                x[i] = sum;
+            }
+        }
+    }
+}
+
+void lu_back_sub(const double LU[], int n, double x[], int nb,
+                 int thread_count) {
+    /* The last block row holds whatever is left over */
+    int last = ((n - 1)/nb)*nb;
+
+#   pragma omp parallel num_threads(thread_count) \
+        default(none) shared(LU, n, x, nb, last)
+    {
+        int r0, r1, i, j;
+        double sum;
+
+        for (r0 = last; r0 >= 0; r0 -= nb) {
+            r1 = min(r0 + nb, n);
+#           pragma omp single
+            for (i = r1-1; i >= r0; i--) {
+                sum = x[i];
+                for (j = i+1; j < r1; j++)
+                    sum -= LU[i*n+j]*x[j];
+                x[i] = sum / LU[i*n+i];
+            }
+
+#           pragma omp for schedule(static)
+            for (i = 0; i < r0; i++) {
+                sum = x[i];
+                for (j = r0; j < r1; j++)
+                    sum -= LU[i*n+j]*x[j];
+                x[i] = sum;
+            }
+        }
+    }
+}
+
+void lu_solve(const double LU[], const int piv[], int n, double b[], int nb,
+              int thread_count) {
+    int i;
+    double tmp;
+
+    for (i = 0; i < n; i++)
+        if (piv[i] != i) {
+            tmp = b[i];
+            b[i] = b[piv[i]];
+            b[piv[i]] = tmp;
+        }
+    lu_forward_sub(LU, n, b, nb, thread_count);
+    lu_back_sub(LU, n, b, nb, thread_count);
+}
+
+/* Solve for columns c0..c1-1 of the n x k B.  Once a block of rows of
+ * the solution is known, its product with the rows of L (or U) beyond
+ * it is subtracted while the block is still in cache. */
+static void solve_columns(const double LU[], const int piv[], int n,
+                          double B[], int k, int nb, int c0, int c1) {
+    int i, j, c, r0, r1, last;
+    double l, tmp;
+    double *row_i, *row_j;
+
+    for (i = 0; i < n; i++)
+        if (piv[i] != i)
+            for (c = c0; c < c1; c++) {
+                tmp = B[i*k+c];
+                B[i*k+c] = B[piv[i]*k+c];
+                B[piv[i]*k+c] = tmp;
+            }
+
+    for (r0 = 0; r0 < n; r0 += nb) {
+        r1 = min(r0 + nb, n);
+        for (i = r0+1; i < n; i++) {
+            row_i = &B[i*k];
+            for (j = r0; j < min(i, r1); j++) {
+                l = LU[i*n+j];
+                row_j = &B[j*k];
+                for (c = c0; c < c1; c++)
+                    row_i[c] -= l*row_j[c];
+            }
+        }
+    }
+
+    last = ((n - 1)/nb)*nb;
+    for (r0 = last; r0 >= 0; r0 -= nb) {
+        r1 = min(r0 + nb, n);
+        for (i = r1-1; i >= r0; i--) {
+            row_i = &B[i*k];
+            for (j = i+1; j < r1; j++) {
+                l = LU[i*n+j];
+                row_j = &B[j*k];
+                for (c = c0; c < c1; c++)
+                    row_i[c] -= l*row_j[c];
+            }
+            l = 1.0 / LU[i*n+i];
+            for (c = c0; c < c1; c++)
+                row_i[c] *= l;
+        }
+        for (i = 0; i < r0; i++) {
+            row_i = &B[i*k];
+            for (j = r0; j < r1; j++) {
+                l = LU[i*n+j];
+                row_j = &B[j*k];
+                for (c = c0; c < c1; c++)
+                    row_i[c] -= l*row_j[c];
+            }
+        }
+    }
+}
+
+void lu_solve_many(const double LU[], const int piv[], int n, double B[],
+                   int k, int nb, int thread_count) {
+    int c0, c, i, cols;
+    double* x;
+
+    if (k == 1) {
+        lu_solve(LU, piv, n, B, nb, thread_count);
+        return;
+    }
+
+    if (k < thread_count) {
+        /* Too few columns to go round: split the rows of each solve */
+        x = malloc(n*sizeof(double));
+        for (c = 0; c < k; c++) {
+            for (i = 0; i < n; i++) x[i] = B[i*k+c];
+            lu_solve(LU, piv, n, x, nb, thread_count);
+            for (i = 0; i < n; i++) B[i*k+c] = x[i];
+        }
+        free(x);
+        return;
+    }
+
+    /* At most RHS_COLS columns a group, and enough groups for every thread */
+    cols = min(RHS_COLS, (k + thread_count - 1)/thread_count);
+#   pragma omp parallel for num_threads(thread_count) schedule(dynamic) \
+        default(none) shared(LU, piv, n, B, k, nb, cols)
+    for (c0 = 0; c0 < k; c0 += cols)
+        solve_columns(LU, piv, n, B, k, nb, c0, min(c0 + cols, k));
+}
+
+double lu_flops(int n) {
+    return 2.0*n*(double)n*n/3.0;
+}
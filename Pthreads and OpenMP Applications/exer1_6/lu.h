@@ -0,0 +1,160 @@
+#ifndef LU_H
+#define LU_H
+
+#include <sys/types.h>
+
+/* Columns per panel, unless given on the command line */
+#define LU_DEFAULT_BLOCK 64
+
+/* Blocked right-looking LU with partial pivoting, in place on the n x n
+ * row-major A.  Afterwards the strict lower triangle holds L (its unit
+ * diagonal is implied) and the upper triangle holds U, and at step i
+ * row i was swapped with row piv[i].  Returns 0, or k+1 if U[k][k] is
+ * exactly zero. */
+int  lu_factor(double A[], int n, int piv[], int nb, int thread_count);
+
+/* One task of lu_factor_tasks: which step and column block it worked
+ * on, the thread that ran it and when, in seconds from the start */
+typedef enum { LU_TASK_PANEL, LU_TASK_UPDATE, LU_TASK_SWAP } lu_task_kind;
+
+typedef struct {
+    lu_task_kind kind;
+    int step, col, thread;
+    double start, end;
+} lu_task_event;
+
+typedef struct {
+    lu_task_event* events;
+    int count, capacity;
+    double origin;
+} lu_trace;
+
+/* lu_factor as a DAG of OpenMP tasks in one parallel region: a panel
+ * task per step and an update task per column block to its right,
+ * ordered by depend clauses on the column blocks, so the panel of step
+ * k+1 runs as soon as its own column block has been updated by step k.
+ * The row swaps left of each panel are applied by a last round of
+ * tasks.  If trace is not NULL every task is recorded in it. */
+int  lu_factor_tasks(double A[], int n, int piv[], int nb, int thread_count,
+                     lu_trace* trace);
+
+/* Room for the tasks lu_factor_tasks creates; free with lu_trace_free */
+void lu_trace_init(lu_trace* trace, int n, int nb);
+void lu_trace_free(lu_trace* trace);
+
+/* Triangular solves in place on x, nb rows at a time: each diagonal
+ * block is solved by one thread, then the team subtracts its product
+ * with the new part of x from the rest of the right-hand side.  The
+ * forward solve uses the unit lower triangle of LU, the back solve the
+ * upper triangle; nothing else is read. */
+void lu_forward_sub(const double LU[], int n, double x[], int nb,
+                    int thread_count);
+void lu_back_sub(const double LU[], int n, double x[], int nb,
+                 int thread_count);
+
+/* Overwrite b with the solution of A x = b, given lu_factor's output */
+void lu_solve(const double LU[], const int piv[], int n, double b[], int nb,
+              int thread_count);
+
+/* Overwrite the k right-hand sides in the n x k row-major B with the
+ * solutions, given lu_factor's output.  Threads take RHS_COLS columns
+ * each and run a blocked forward and back solve on them, so the
+ * factorisation is read once per column group rather than once per
+ * right-hand side. */
+void lu_solve_many(const double LU[], const int piv[], int n, double B[],
+                   int k, int nb, int thread_count);
+
+/* Refinement steps before lu_solve_mixed gives up on single precision */
+#define LU_MIXED_MAX_ITER 30
+
+typedef struct {
+    int iterations;         /* refinement steps taken */
+    int fell_back;          /* 1 if the double factorisation was needed */
+    double residual;        /* ||b-Ax||_inf / (||A||_inf ||x||_inf + ||b||_inf) */
+    double factor_time, refine_time, fallback_time;
+} lu_mixed_stats;
+
+/* lu_factor on a float matrix (lu_mixed.c) */
+int  lu_factor_single(float A[], int n, int piv[], int nb, int thread_count);
+
+/* Solve A x = b by factoring a float copy of A, then refining x with
+ * residuals computed in double until the residual is at double
+ * precision level.  If a step fails to halve the residual, A is
+ * factored in double instead.  A and b are not changed.  Returns the
+ * info of the last factorisation. */
+int  lu_solve_mixed(const double A[], int n, const double b[], double x[],
+                    int nb, int thread_count, lu_mixed_stats* stats);
+
+/* Out-of-core LU (lu_ooc.c).  A file holds the n x n matrix as column
+ * blocks of nb columns, block j at lu_ooc_offset(n, nb, j), each block
+ * stored row-major with lu_ooc_width(n, nb, j) doubles per row. */
+typedef struct {
+    long long bytes_read, bytes_written;
+    double io_time;         /* time the I/O thread spent reading and writing */
+    double stall_time;      /* time the computation waited for I/O */
+    double total_time;
+} lu_ooc_stats;
+
+off_t lu_ooc_offset(int n, int nb, int j);
+int  lu_ooc_width(int n, int nb, int j);
+
+/* Factor the matrix in a_path into lu_path, same layout, holding five
+ * column blocks in memory.  Returns as lu_factor, or -1 with errno set
+ * if a file could not be opened, read or written. */
+int  lu_ooc_factor(const char* a_path, const char* lu_path, int n, int nb,
+                   int piv[], int thread_count, lu_ooc_stats* stats);
+
+/* Overwrite b with the solution, streaming the factors from lu_path.
+ * Returns 0, or -1 with errno set on an I/O error. */
+int  lu_ooc_solve(const char* lu_path, int n, int nb, const int piv[],
+                  double b[], lu_ooc_stats* stats);
+
+/* Band LU (lu_band.c) for kl subdiagonals and ku superdiagonals.  Row
+ * i of the band storage holds columns i-kl .. i+ku+kl, the last kl for
+ * the fill-in of the row swaps: element (i,j) is at
+ * AB[i*LU_BAND_LD(kl,ku) + j-i+kl], and entries outside the matrix or
+ * the band must be zero before factoring. */
+#define LU_BAND_LD(kl, ku) (2*(kl) + (ku) + 1)
+
+int  lu_band_factor(double AB[], int n, int kl, int ku, int piv[],
+                    int thread_count);
+void lu_band_solve(const double AB[], int n, int kl, int ku, const int piv[],
+                   double b[]);
+double lu_band_flops(int n, int kl, int ku);
+
+/* A factorisation kept up to date under low-rank updates (lu_update.c).
+ * Updates A += U V^T are collected, with Z = A^-1 U, and solves apply
+ * the Sherman-Morrison-Woodbury correction through the rank x rank
+ * capacitance matrix C = I + V^T Z.  When the collected rank would pass
+ * max_rank (at most n/3, where the solves for Z have cost as much as a
+ * new factorisation) or C's pivots spread by more than 1e10, the
+ * updates are applied to A and it is factored again. */
+typedef struct {
+    int n, nb, thread_count;
+    double* A;              /* A as of the last factorisation */
+    double* LU;
+    int* piv;
+    int info;               /* lu_factor's result for LU */
+    int rank, max_rank;     /* columns of U, V, Z in use, and their width */
+    double *U, *V, *Z;      /* n x max_rank, row-major */
+    double* C;              /* rank x rank, factored */
+    int* cpiv;
+    int refactors;          /* factorisations since lu_upd_init */
+} lu_updatable;
+
+/* Copy and factor A; returns the info of lu_factor */
+int  lu_upd_init(lu_updatable* f, const double A[], int n, int nb,
+                 int max_rank, int thread_count);
+
+/* A += U V^T for the n x k row-major U and V; returns 1 if A was
+ * factored again */
+int  lu_upd_update(lu_updatable* f, const double U[], const double V[], int k);
+
+/* Overwrite b with the solution for the updated A */
+void lu_upd_solve(lu_updatable* f, double b[]);
+void lu_upd_free(lu_updatable* f);
+
+/* Floating point operations of an n x n LU factorisation */
+double lu_flops(int n);
+
+#endif // LU_H
@@ -0,0 +1,92 @@
+#include <math.h>
+#include <omp.h>
+#include "lu.h"
+
+/* Band LU with partial pivoting.  A row swap can move a row up by at
+ * most kl, so U gets up to ku+kl superdiagonals; the band storage
+ * leaves room for them.  Step p updates only the kl rows below the
+ * pivot, over the ku+kl columns right of it, so the cost is
+ * O(n*kl*(kl+ku)).  Those rows are independent and are shared out
+ * among the threads when the band is wide enough to pay for the
+ * barrier each step needs. */
+#define BAND_PAR_MIN 4096
+
+static inline int min(int a, int b) { return a < b ? a : b; }
+
+/* Element (i,j) of the band */
+#define AB_(i, j) AB[(size_t)(i)*ld + (j) - (i) + kl]
+
+int lu_band_factor(double AB[], int n, int kl, int ku, int piv[],
+                   int thread_count) {
+    int ld = LU_BAND_LD(kl, ku);
+    int info = 0;
+
+#   pragma omp parallel num_threads(thread_count) \
+        if ((long)kl*(kl+ku) >= BAND_PAR_MIN) \
+        default(none) shared(AB, n, kl, ku, piv, ld, info)
+    {
+        int p, i, j, best, last_row, last_col;
+        double max, pivot, l, tmp;
+
+        for (p = 0; p < n; p++) {
+            last_row = min(n-1, p+kl);
+            last_col = min(n-1, p+ku+kl);
+#           pragma omp single
+            {
+                best = p;
+                max = fabs(AB_(p, p));
+                for (i = p+1; i <= last_row; i++)
+                    if (fabs(AB_(i, p)) > max) {
+                        max = fabs(AB_(i, p));
+                        best = i;
+                    }
+                piv[p] = best;
+                if (best != p)
+                    for (j = p; j <= last_col; j++) {
+                        tmp = AB_(p, j);
+                        AB_(p, j) = AB_(best, j);
+                        AB_(best, j) = tmp;
+                    }
+                if (AB_(p, p) == 0.0 && info == 0) info = p+1;
+            }
+
+            pivot = AB_(p, p);
+            if (pivot == 0.0) continue;
+#           pragma omp for schedule(static)
+            for (i = p+1; i <= last_row; i++) {
+                l = AB_(i, p) /= pivot;
+                if (l != 0.0)
+                    for (j = p+1; j <= last_col; j++)
+                        AB_(i, j) -= l*AB_(p, j);
+            }
+        }
+    }
+    return info;
+}
+
+void lu_band_solve(const double AB[], int n, int kl, int ku, const int piv[],
+                   double b[]) {
+    int ld = LU_BAND_LD(kl, ku);
+    int i, j;
+    double tmp, sum;
+
+    for (i = 0; i < n; i++) {
+        if (piv[i] != i) {
+            tmp = b[i];
+            b[i] = b[piv[i]];
+            b[piv[i]] = tmp;
+        }
+        for (j = i+1; j <= min(n-1, i+kl); j++)
+            b[j] -= AB_(j, i)*b[i];
+    }
+    for (i = n-1; i >= 0; i--) {
+        sum = b[i];
+        for (j = i+1; j <= min(n-1, i+ku+kl); j++)
+            sum -= AB_(i, j)*b[j];
+        b[i] = sum / AB_(i, i);
+    }
+}
+
+double lu_band_flops(int n, int kl, int ku) {
+    return 2.0*n*(double)kl*(kl+ku);
+}
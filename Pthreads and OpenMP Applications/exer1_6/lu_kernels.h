@@ -0,0 +1,173 @@
+/* Kernels of the blocked right-looking LU, written once for both
+ * precisions.  lu.c includes this file for double and lu_mixed.c, with
+ * LU_KERNELS_SINGLE defined, for float; the names of the float versions
+ * end in _single. */
+
+#ifndef LU_KERNELS_COMMON
+#define LU_KERNELS_COMMON
+
+/* Each step k factors the panel of columns k0..k0+kb-1, then
+ *   1. applies the panel's row swaps to the other columns,
+ *   2. solves L11 U12 = A12 for the block row right of the panel,
+ *   3. updates the trailing matrix A22 -= L21 U12.
+ * Step 3 is a matrix multiply and holds almost all of the flops; it is
+ * split into GEMM_ROWS x GEMM_COLS tiles so a tile of U12 stays in
+ * cache while the rows of L21 stream past it. */
+#define GEMM_ROWS 64
+#define GEMM_COLS 256
+
+static inline int min(int a, int b) { return a < b ? a : b; }
+
+#endif // LU_KERNELS_COMMON
+
+#ifdef LU_KERNELS_SINGLE
+#define REAL float
+#define REAL_ABS fabsf
+#define LU_NAME(name) name##_single
+#else
+#define REAL double
+#define REAL_ABS fabs
+#define LU_NAME(name) name
+#endif
+
+/* Unblocked LU of rows k0..n-1 of columns k0..k0+kb-1.  Row swaps are
+ * only applied inside the panel. */
+static int LU_NAME(panel_factor)(REAL A[], int n, int k0, int kb, int piv[]) {
+    int p, i, c, best, end = k0 + kb, info = 0;
+    REAL max, pivot, l, tmp;
+    REAL *row_p, *row_i;
+
+    for (p = k0; p < end; p++) {
+        best = p;
+        max = REAL_ABS(A[p*n+p]);
+        for (i = p+1; i < n; i++)
+            if (REAL_ABS(A[i*n+p]) > max) {
+                max = REAL_ABS(A[i*n+p]);
+                best = i;
+            }
+        piv[p] = best;
+        if (best != p)
+            for (c = k0; c < end; c++) {
+                tmp = A[p*n+c];
+                A[p*n+c] = A[best*n+c];
+                A[best*n+c] = tmp;
+            }
+        pivot = A[p*n+p];
+        if (pivot == 0) {
+            if (info == 0) info = p+1;
+            continue;
+        }
+
+        row_p = &A[p*n];
+        for (i = p+1; i < n; i++) {
+            row_i = &A[i*n];
+            l = row_i[p] /= pivot;
+            for (c = p+1; c < end; c++)
+                row_i[c] -= l*row_p[c];
+        }
+    }
+    return info;
+}
+
+/* Apply the swaps of the panel starting at k0 to columns c0..c1-1 */
+static void LU_NAME(swap_rows)(REAL A[], int n, const int piv[], int k0, int kb,
+                               int c0, int c1) {
+    int p, c;
+    REAL tmp;
+
+    for (p = k0; p < k0+kb; p++)
+        if (piv[p] != p)
+            for (c = c0; c < c1; c++) {
+                tmp = A[p*n+c];
+                A[p*n+c] = A[piv[p]*n+c];
+                A[piv[p]*n+c] = tmp;
+            }
+}
+
+/* U12 = L11^-1 A12 on columns c0..c1-1 */
+static void LU_NAME(trsm_unit_lower)(REAL A[], int n, int k0, int kb,
+                                     int c0, int c1) {
+    int i, p, c;
+    REAL l;
+    REAL *row_i, *row_p;
+
+    for (i = k0+1; i < k0+kb; i++) {
+        row_i = &A[i*n];
+        for (p = k0; p < i; p++) {
+            l = row_i[p];
+            row_p = &A[p*n];
+            for (c = c0; c < c1; c++)
+                row_i[c] -= l*row_p[c];
+        }
+    }
+}
+
+/* A[r0:r1, c0:c1] -= A[r0:r1, k0:k0+kb] * A[k0:k0+kb, c0:c1], four rows
+ * of U12 at a time so each element of A22 is loaded and stored once
+ * per four multiply-adds */
+static void LU_NAME(gemm_update)(REAL A[], int n, int k0, int kb,
+                                 int r0, int r1, int c0, int c1) {
+    int i, p, c, end = k0 + kb;
+    REAL l0, l1, l2, l3;
+    REAL *row_i, *u0, *u1, *u2, *u3;
+
+    for (i = r0; i < r1; i++) {
+        row_i = &A[i*n];
+        for (p = k0; p + 3 < end; p += 4) {
+            l0 = row_i[p];   l1 = row_i[p+1];
+            l2 = row_i[p+2]; l3 = row_i[p+3];
+            u0 = &A[p*n];     u1 = &A[(p+1)*n];
+            u2 = &A[(p+2)*n]; u3 = &A[(p+3)*n];
+            for (c = c0; c < c1; c++)
+                row_i[c] -= l0*u0[c] + l1*u1[c] + l2*u2[c] + l3*u3[c];
+        }
+        for (; p < end; p++) {
+            l0 = row_i[p];
+            u0 = &A[p*n];
+            for (c = c0; c < c1; c++)
+                row_i[c] -= l0*u0[c];
+        }
+    }
+}
+
+int LU_NAME(lu_factor)(REAL A[], int n, int piv[], int nb, int thread_count) {
+    int k0, kb, end, info = 0, step_info;
+
+    for (k0 = 0; k0 < n; k0 += nb) {
+        kb = min(nb, n - k0);
+        end = k0 + kb;
+        step_info = LU_NAME(panel_factor)(A, n, k0, kb, piv);
+        if (info == 0) info = step_info;
+
+#       pragma omp parallel num_threads(thread_count) \
+            default(none) shared(A, n, piv, k0, kb, end)
+        {
+            int r, c;
+
+#           pragma omp for schedule(static)
+            for (c = 0; c < n; c += GEMM_COLS) {
+                /* Skip the panel itself, already swapped */
+                if (c < k0)
+                    LU_NAME(swap_rows)(A, n, piv, k0, kb, c, min(c+GEMM_COLS, k0));
+                if (c+GEMM_COLS > end)
+                    LU_NAME(swap_rows)(A, n, piv, k0, kb, c > end ? c : end,
+                                       min(c+GEMM_COLS, n));
+            }
+
+#           pragma omp for schedule(static)
+            for (c = end; c < n; c += GEMM_COLS)
+                LU_NAME(trsm_unit_lower)(A, n, k0, kb, c, min(c+GEMM_COLS, n));
+
+#           pragma omp for collapse(2) schedule(dynamic)
+            for (r = end; r < n; r += GEMM_ROWS)
+                for (c = end; c < n; c += GEMM_COLS)
+                    LU_NAME(gemm_update)(A, n, k0, kb, r, min(r+GEMM_ROWS, n),
+                                         c, min(c+GEMM_COLS, n));
+        }
+    }
+    return info;
+}
+
+#undef REAL
+#undef REAL_ABS
+#undef LU_NAME
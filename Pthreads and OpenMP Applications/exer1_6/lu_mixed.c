@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <omp.h>
+#include "lu.h"
+
+/* The float factorisation is the same blocked right-looking LU as
+ * lu_factor, from the same kernels */
+#define LU_KERNELS_SINGLE
+#include "lu_kernels.h"
+
+/* Solve with the float factors for a double right-hand side,
+ * accumulating in double */
+static void solve_single(const float LU[], const int piv[], int n, double x[]) {
+    int i, j;
+    double tmp, sum;
+
+    for (i = 0; i < n; i++)
+        if (piv[i] != i) {
+            tmp = x[i];
+            x[i] = x[piv[i]];
+            x[piv[i]] = tmp;
+        }
+    for (i = 1; i < n; i++) {
+        sum = x[i];
+        for (j = 0; j < i; j++)
+            sum -= LU[i*n+j]*x[j];
+        x[i] = sum;
+    }
+    for (i = n-1; i >= 0; i--) {
+        sum = x[i];
+        for (j = i+1; j < n; j++)
+            sum -= LU[i*n+j]*x[j];
+        x[i] = sum / LU[i*n+i];
+    }
+}
+
+/* r = b - A x in double; returns ||r||_inf / (||A||_inf ||x||_inf + ||b||_inf) */
+static double residual(const double A[], int n, const double b[],
+                       const double x[], double r[], double a_norm,
+                       int thread_count) {
+    int i;
+    double r_max = 0.0, x_max = 0.0, b_max = 0.0;
+
+#   pragma omp parallel for num_threads(thread_count) \
+        default(none) shared(A, n, b, x, r) \
+        reduction(max: r_max, x_max, b_max)
+    for (i = 0; i < n; i++) {
+        int j;
+        double sum = b[i];
+        for (j = 0; j < n; j++)
+            sum -= A[(size_t)i*n+j]*x[j];
+        r[i] = sum;
+        if (fabs(sum) > r_max) r_max = fabs(sum);
+        if (fabs(x[i]) > x_max) x_max = fabs(x[i]);
+        if (fabs(b[i]) > b_max) b_max = fabs(b[i]);
+    }
+    return r_max / (a_norm*x_max + b_max);
+}
+
+int lu_solve_mixed(const double A[], int n, const double b[], double x[],
+                   int nb, int thread_count, lu_mixed_stats* stats) {
+    float* LU_s = malloc((size_t)n*n*sizeof(float));
+    int* piv = malloc(n*sizeof(int));
+    double* r = malloc(n*sizeof(double));
+    double *LU_d, a_norm = 0.0, res, prev, t0 = omp_get_wtime();
+    double tol = DBL_EPSILON*sqrt((double) n);
+    int i, it, info;
+
+#   pragma omp parallel for num_threads(thread_count) \
+        default(none) shared(A, n, LU_s) reduction(max: a_norm)
+    for (i = 0; i < n; i++) {
+        int j;
+        double row_sum = 0.0;
+        for (j = 0; j < n; j++) {
+            LU_s[(size_t)i*n+j] = (float) A[(size_t)i*n+j];
+            row_sum += fabs(A[(size_t)i*n+j]);
+        }
+        if (row_sum > a_norm) a_norm = row_sum;
+    }
+    info = lu_factor_single(LU_s, n, piv, nb, thread_count);
+    stats->factor_time = omp_get_wtime() - t0;
+    stats->fell_back = 0;
+
+    t0 = omp_get_wtime();
+    it = 0;
+    res = INFINITY;
+    if (info == 0) {
+        memcpy(x, b, n*sizeof(double));
+        solve_single(LU_s, piv, n, x);
+        res = residual(A, n, b, x, r, a_norm, thread_count);
+        prev = INFINITY;
+        /* Stop at double accuracy; give up when a step no longer
+         * halves the residual or the iterations run out */
+        while (isfinite(res) && res > tol && it < LU_MIXED_MAX_ITER
+               && res < 0.5*prev) {
+            solve_single(LU_s, piv, n, r);
+            for (i = 0; i < n; i++)
+                x[i] += r[i];
+            prev = res;
+            res = residual(A, n, b, x, r, a_norm, thread_count);
+            it++;
+        }
+    }
+    stats->iterations = it;
+    stats->refine_time = omp_get_wtime() - t0;
+    free(LU_s);
+
+    if (!(res <= tol)) {
+        /* Refinement stalled: factor in double after all */
+        t0 = omp_get_wtime();
+        LU_d = malloc((size_t)n*n*sizeof(double));
+        memcpy(LU_d, A, (size_t)n*n*sizeof(double));
+        info = lu_factor(LU_d, n, piv, nb, thread_count);
+        memcpy(x, b, n*sizeof(double));
+        lu_solve(LU_d, piv, n, x, nb, thread_count);
+        res = residual(A, n, b, x, r, a_norm, thread_count);
+        free(LU_d);
+        stats->fell_back = 1;
+        stats->fallback_time = omp_get_wtime() - t0;
+    } else {
+        stats->fallback_time = 0.0;
+    }
+    stats->residual = res;
+
+    free(piv);
+    free(r);
+    return info;
+}
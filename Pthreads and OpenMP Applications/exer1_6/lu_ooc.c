@@ -0,0 +1,406 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <omp.h>
+#include "lu.h"
+
+/* Left-looking LU on column blocks kept in files.  Step j reads block j
+ * of A, applies every earlier step to it (row swaps, then the updates
+ * with the L part of that step's block, read back from the LU file),
+ * factors it and writes it to the LU file.  Only five blocks are in
+ * memory: three that rotate between being read ahead from A, factored
+ * and written out, so block j+1 of A arrives while step j computes, and
+ * two buffers that take turns receiving the next L block from an I/O
+ * thread while the current one is used.
+ *
+ * Later row swaps are never applied to the L blocks already written;
+ * lu_ooc_solve applies the swaps of each step just before using that
+ * step's block, which gives the same result. */
+
+static inline int min(int a, int b) { return a < b ? a : b; }
+
+/*-------------------------------------------------------------------*/
+/* I/O thread: serves reads and writes in submission order.  A failed  */
+/* transfer leaves its errno in error, which io_wait reports           */
+#define IO_QUEUE 8
+
+typedef struct {
+    int fd, write, done, error;
+    double* buf;
+    size_t bytes;
+    off_t offset;
+} io_request;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    io_request* queue[IO_QUEUE];
+    int head, tail, quit;
+    lu_ooc_stats* stats;
+} io_worker;
+
+static void transfer(io_request* req) {
+    char* p = (char*) req->buf;
+    size_t left = req->bytes;
+    off_t offset = req->offset;
+    ssize_t moved;
+
+    while (left > 0) {
+        moved = req->write ? pwrite(req->fd, p, left, offset)
+                           : pread(req->fd, p, left, offset);
+        if (moved < 0 && errno == EINTR) continue;
+        if (moved <= 0) {
+            /* A block past the end of the file is an error as well */
+            req->error = moved < 0 ? errno : (req->write ? ENOSPC : EIO);
+            break;
+        }
+        p += moved;
+        offset += moved;
+        left -= moved;
+    }
+}
+
+static void* io_thread(void* arg) {
+    io_worker* w = arg;
+    io_request* req;
+    double t0;
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        while (w->head == w->tail && !w->quit)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        if (w->head == w->tail) break;
+        req = w->queue[w->head % IO_QUEUE];
+        pthread_mutex_unlock(&w->mutex);
+
+        t0 = omp_get_wtime();
+        transfer(req);
+
+        pthread_mutex_lock(&w->mutex);
+        w->stats->io_time += omp_get_wtime() - t0;
+        if (req->write) w->stats->bytes_written += req->bytes;
+        else w->stats->bytes_read += req->bytes;
+        req->done = 1;
+        w->head++;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+
+static void io_submit(io_worker* w, io_request* req, int fd, int write,
+                      double* buf, size_t bytes, off_t offset) {
+    req->fd = fd;
+    req->write = write;
+    req->buf = buf;
+    req->bytes = bytes;
+    req->offset = offset;
+    req->done = 0;
+    req->error = 0;
+    pthread_mutex_lock(&w->mutex);
+    while (w->tail - w->head == IO_QUEUE)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    w->queue[w->tail++ % IO_QUEUE] = req;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/* Block until req is done, charging the wait to the stall time.
+ * Returns 0, or -1 with errno set if the transfer failed. */
+static int io_wait(io_worker* w, io_request* req) {
+    double t0 = omp_get_wtime();
+
+    pthread_mutex_lock(&w->mutex);
+    while (!req->done)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    pthread_mutex_unlock(&w->mutex);
+    w->stats->stall_time += omp_get_wtime() - t0;
+    if (req->error != 0) {
+        errno = req->error;
+        return -1;
+    }
+    return 0;
+}
+
+static void io_start(io_worker* w, lu_ooc_stats* stats) {
+    w->head = w->tail = w->quit = 0;
+    w->stats = stats;
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    pthread_create(&w->thread, NULL, io_thread, w);
+}
+
+static void io_stop(io_worker* w) {
+    pthread_mutex_lock(&w->mutex);
+    w->quit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+    pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->mutex);
+    pthread_cond_destroy(&w->cond);
+}
+
+/*-------------------------------------------------------------------*/
+off_t lu_ooc_offset(int n, int nb, int j) {
+    return (off_t) n*j*nb*sizeof(double);
+}
+
+int lu_ooc_width(int n, int nb, int j) {
+    return min(nb, n - j*nb);
+}
+
+/* Apply step k (block L of width wk, first column k0) to the n x w
+ * block X: swap rows, solve with the unit lower diagonal block, then
+ * subtract L21 times the new rows k0..k0+wk-1 from the rows below */
+static void apply_step(double X[], int w, const double L[], int wk, int k0,
+                       const int piv[], int n, int thread_count) {
+    int p, i, c, k1 = k0 + wk;
+    double l, tmp, *row_i, *row_p;
+
+    for (p = k0; p < k1; p++)
+        if (piv[p] != p)
+            for (c = 0; c < w; c++) {
+                tmp = X[(size_t)p*w+c];
+                X[(size_t)p*w+c] = X[(size_t)piv[p]*w+c];
+                X[(size_t)piv[p]*w+c] = tmp;
+            }
+
+    for (i = k0+1; i < k1; i++) {
+        row_i = &X[(size_t)i*w];
+        for (p = k0; p < i; p++) {
+            l = L[(size_t)i*wk + p-k0];
+            row_p = &X[(size_t)p*w];
+            for (c = 0; c < w; c++)
+                row_i[c] -= l*row_p[c];
+        }
+    }
+
+#   pragma omp parallel for num_threads(thread_count) schedule(static) \
+        default(none) private(p, c, l, row_i, row_p) \
+        shared(X, w, L, wk, k0, k1, n)
+    for (i = k1; i < n; i++) {
+        row_i = &X[(size_t)i*w];
+        for (p = k0; p < k1; p++) {
+            l = L[(size_t)i*wk + p-k0];
+            if (l == 0.0) continue;
+            row_p = &X[(size_t)p*w];
+            for (c = 0; c < w; c++)
+                row_i[c] -= l*row_p[c];
+        }
+    }
+}
+
+/* Unblocked LU with partial pivoting of rows j0..n-1 of the block */
+static int factor_block(double X[], int w, int j0, int n, int piv[]) {
+    int p, i, c, best, info = 0;
+    double max, pivot, l, tmp, *row_p, *row_i;
+
+    for (p = 0; p < w; p++) {
+        best = j0+p;
+        max = fabs(X[(size_t)(j0+p)*w+p]);
+        for (i = j0+p+1; i < n; i++)
+            if (fabs(X[(size_t)i*w+p]) > max) {
+                max = fabs(X[(size_t)i*w+p]);
+                best = i;
+            }
+        piv[j0+p] = best;
+        if (best != j0+p)
+            for (c = 0; c < w; c++) {
+                tmp = X[(size_t)(j0+p)*w+c];
+                X[(size_t)(j0+p)*w+c] = X[(size_t)best*w+c];
+                X[(size_t)best*w+c] = tmp;
+            }
+        pivot = X[(size_t)(j0+p)*w+p];
+        if (pivot == 0.0) {
+            if (info == 0) info = j0+p+1;
+            continue;
+        }
+        row_p = &X[(size_t)(j0+p)*w];
+        for (i = j0+p+1; i < n; i++) {
+            row_i = &X[(size_t)i*w];
+            l = row_i[p] /= pivot;
+            for (c = p+1; c < w; c++)
+                row_i[c] -= l*row_p[c];
+        }
+    }
+    return info;
+}
+
+int lu_ooc_factor(const char* a_path, const char* lu_path, int n, int nb,
+                  int piv[], int thread_count, lu_ooc_stats* stats) {
+    int blocks = (n + nb - 1)/nb;
+    int j, k, w, wk, info = 0, step_info, failed = 0;  /* errno of a failure */
+    size_t block_bytes = (size_t)n*nb*sizeof(double);
+    double* cur[3];
+    double* prefetch[2];
+    io_request a_req[2], write_req[3], l_req[2];
+    io_worker io;
+    int a_fd, lu_fd;
+    double t0 = omp_get_wtime();
+
+    memset(stats, 0, sizeof(*stats));
+    a_fd = open(a_path, O_RDONLY);
+    lu_fd = open(lu_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (a_fd < 0 || lu_fd < 0) {
+        if (a_fd >= 0) close(a_fd);
+        if (lu_fd >= 0) close(lu_fd);
+        return -1;
+    }
+    for (k = 0; k < 3; k++) {
+        cur[k] = malloc(block_bytes);
+        write_req[k].done = 1;
+        write_req[k].error = 0;
+    }
+    for (k = 0; k < 2; k++)
+        prefetch[k] = malloc(block_bytes);
+    io_start(&io, stats);
+
+    io_submit(&io, &a_req[0], a_fd, 0, cur[0],
+              (size_t)n*lu_ooc_width(n, nb, 0)*sizeof(double),
+              lu_ooc_offset(n, nb, 0));
+    for (j = 0; j < blocks; j++) {
+        double* X = cur[j % 3];
+        w = lu_ooc_width(n, nb, j);
+
+        if (j > 0)
+            io_submit(&io, &l_req[0], lu_fd, 0, prefetch[0],
+                      (size_t)n*lu_ooc_width(n, nb, 0)*sizeof(double),
+                      lu_ooc_offset(n, nb, 0));
+        /* Read block j+1 ahead, into the buffer block j-2 was written
+         * out from */
+        if (j+1 < blocks) {
+            if (io_wait(&io, &write_req[(j+1) % 3]) != 0) {
+                failed = errno;
+                break;
+            }
+            io_submit(&io, &a_req[(j+1) % 2], a_fd, 0, cur[(j+1) % 3],
+                      (size_t)n*lu_ooc_width(n, nb, j+1)*sizeof(double),
+                      lu_ooc_offset(n, nb, j+1));
+        }
+        if (io_wait(&io, &a_req[j % 2]) != 0) {
+            failed = errno;
+            break;
+        }
+
+        for (k = 0; k < j; k++) {
+            if (io_wait(&io, &l_req[k % 2]) != 0) {
+                failed = errno;
+                break;
+            }
+            if (k+1 < j)
+                io_submit(&io, &l_req[(k+1) % 2], lu_fd, 0, prefetch[(k+1) % 2],
+                          (size_t)n*lu_ooc_width(n, nb, k+1)*sizeof(double),
+                          lu_ooc_offset(n, nb, k+1));
+            wk = lu_ooc_width(n, nb, k);
+            apply_step(X, w, prefetch[k % 2], wk, k*nb, piv, n, thread_count);
+        }
+        if (failed) break;
+
+        step_info = factor_block(X, w, j*nb, n, piv);
+        if (info == 0) info = step_info;
+        io_submit(&io, &write_req[j % 3], lu_fd, 1, X,
+                  (size_t)n*w*sizeof(double), lu_ooc_offset(n, nb, j));
+    }
+    /* After a failure this only drains the queue */
+    for (k = 0; k < 3; k++)
+        if (io_wait(&io, &write_req[k]) != 0 && !failed) failed = errno;
+    io_stop(&io);
+
+    for (k = 0; k < 3; k++)
+        free(cur[k]);
+    for (k = 0; k < 2; k++)
+        free(prefetch[k]);
+    close(a_fd);
+    close(lu_fd);
+    stats->total_time = omp_get_wtime() - t0;
+    if (failed) {
+        errno = failed;
+        return -1;
+    }
+    return info;
+}
+
+/* Forward solve block by block in step order, then back solve from the
+ * last block, with the next block always being read in the background */
+int lu_ooc_solve(const char* lu_path, int n, int nb, const int piv[],
+                 double b[], lu_ooc_stats* stats) {
+    int blocks = (n + nb - 1)/nb;
+    int s, j, i, c, p, w, j0, j1, failed = 0;  /* errno of a failure */
+    double* buf[2];
+    double tmp, sum, *X;
+    io_request req[2];
+    io_worker io;
+    int fd = open(lu_path, O_RDONLY);
+    double t0 = omp_get_wtime();
+
+    memset(stats, 0, sizeof(*stats));
+    if (fd < 0) return -1;
+    buf[0] = malloc((size_t)n*nb*sizeof(double));
+    buf[1] = malloc((size_t)n*nb*sizeof(double));
+    io_start(&io, stats);
+
+    /* Pass s visits blocks 0..blocks-1 forward, then blocks-1..0 back */
+    io_submit(&io, &req[0], fd, 0, buf[0],
+              (size_t)n*lu_ooc_width(n, nb, 0)*sizeof(double), 0);
+    for (s = 0; s < 2*blocks; s++) {
+        j = s < blocks ? s : 2*blocks-1 - s;
+        X = buf[s % 2];
+        if (io_wait(&io, &req[s % 2]) != 0) {
+            failed = errno;
+            break;
+        }
+        if (s+1 < 2*blocks) {
+            int next = s+1 < blocks ? s+1 : 2*blocks-2 - s;
+            io_submit(&io, &req[(s+1) % 2], fd, 0, buf[(s+1) % 2],
+                      (size_t)n*lu_ooc_width(n, nb, next)*sizeof(double),
+                      lu_ooc_offset(n, nb, next));
+        }
+        w = lu_ooc_width(n, nb, j);
+        j0 = j*nb;
+        j1 = j0 + w;
+
+        if (s < blocks) {
+            for (p = j0; p < j1; p++)
+                if (piv[p] != p) {
+                    tmp = b[p];
+                    b[p] = b[piv[p]];
+                    b[piv[p]] = tmp;
+                }
+            for (i = j0+1; i < n; i++) {
+                sum = b[i];
+                for (c = 0; c < min(w, i - j0); c++)
+                    sum -= X[(size_t)i*w+c]*b[j0+c];
+                b[i] = sum;
+            }
+        } else {
+            for (i = j1-1; i >= j0; i--) {
+                sum = b[i];
+                for (c = i-j0+1; c < w; c++)
+                    sum -= X[(size_t)i*w+c]*b[j0+c];
+                b[i] = sum / X[(size_t)i*w + i-j0];
+            }
+            for (i = 0; i < j0; i++) {
+                sum = b[i];
+                for (c = 0; c < w; c++)
+                    sum -= X[(size_t)i*w+c]*b[j0+c];
+                b[i] = sum;
+            }
+        }
+    }
+    io_stop(&io);
+
+    free(buf[0]);
+    free(buf[1]);
+    close(fd);
+    stats->total_time = omp_get_wtime() - t0;
+    if (failed) {
+        errno = failed;
+        return -1;
+    }
+    return 0;
+}
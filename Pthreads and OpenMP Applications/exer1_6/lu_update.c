@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "lu.h"
+
+/* Solves after low-rank updates by Sherman-Morrison-Woodbury.  With the
+ * updates since the last factorisation collected as A' = A + U V^T,
+ *     A'^-1 b = y - Z C^-1 V^T y,  y = A^-1 b,  Z = A^-1 U,
+ * and C = I + V^T Z is only rank x rank.  An update of rank k costs k
+ * solves with the old factors; a solve costs one solve plus O(n*rank).
+ * Once the Z solves since the last factorisation have cost as much as a
+ * new factorisation (rank about n/3), or C's pivots spread so far that
+ * the formula loses accuracy, the updates are applied to A and it is
+ * factored again. */
+
+/* Smallest ratio of C's pivots before the updates are folded into A */
+#define UPD_PIVOT_RATIO 1e-10
+
+/* A += U V^T for n x k blocks U and V with ld doubles per row */
+static void add_outer(double A[], int n, const double U[], const double V[],
+                      int k, int ld, int thread_count) {
+    int i;
+
+#   pragma omp parallel for num_threads(thread_count) \
+        default(none) shared(A, n, U, V, k, ld)
+    for (i = 0; i < n; i++) {
+        int j, r;
+        for (r = 0; r < k; r++) {
+            double u = U[(size_t)i*ld+r];
+            if (u == 0.0) continue;
+            for (j = 0; j < n; j++)
+                A[(size_t)i*n+j] += u*V[(size_t)j*ld+r];
+        }
+    }
+}
+
+/* Fold the pending updates into A and factor it again */
+static void refactor(lu_updatable* f) {
+    int n = f->n;
+
+    add_outer(f->A, n, f->U, f->V, f->rank, f->max_rank, f->thread_count);
+    memcpy(f->LU, f->A, (size_t)n*n*sizeof(double));
+    f->info = lu_factor(f->LU, n, f->piv, f->nb, f->thread_count);
+    f->rank = 0;
+    f->refactors++;
+}
+
+/* Rebuild and factor C = I + V^T Z; returns 0 if its pivots have
+ * spread beyond UPD_PIVOT_RATIO */
+static int build_capacitance(lu_updatable* f) {
+    int i, r, s, n = f->n, w = f->max_rank, k = f->rank;
+    double sum, d, d_min = INFINITY, d_max = 0.0;
+
+    for (r = 0; r < k; r++)
+        for (s = 0; s < k; s++) {
+            sum = (r == s) ? 1.0 : 0.0;
+            for (i = 0; i < n; i++)
+                sum += f->V[(size_t)i*w+r]*f->Z[(size_t)i*w+s];
+            f->C[r*k+s] = sum;
+        }
+    if (lu_factor(f->C, k, f->cpiv, LU_DEFAULT_BLOCK, 1) != 0) return 0;
+    for (r = 0; r < k; r++) {
+        d = fabs(f->C[r*k+r]);
+        if (d < d_min) d_min = d;
+        if (d > d_max) d_max = d;
+    }
+    return d_min >= UPD_PIVOT_RATIO*d_max;
+}
+
+int lu_upd_init(lu_updatable* f, const double A[], int n, int nb,
+                int max_rank, int thread_count) {
+    f->n = n;
+    f->nb = nb;
+    f->thread_count = thread_count;
+    /* Past n/3 the Z solves cost more than factoring again */
+    f->max_rank = max_rank < n/3 ? max_rank : (n/3 > 0 ? n/3 : 1);
+    f->rank = 0;
+    f->refactors = 0;
+    f->A = malloc((size_t)n*n*sizeof(double));
+    f->LU = malloc((size_t)n*n*sizeof(double));
+    f->piv = malloc(n*sizeof(int));
+    f->U = malloc((size_t)n*f->max_rank*sizeof(double));
+    f->V = malloc((size_t)n*f->max_rank*sizeof(double));
+    f->Z = malloc((size_t)n*f->max_rank*sizeof(double));
+    f->C = malloc((size_t)f->max_rank*f->max_rank*sizeof(double));
+    f->cpiv = malloc(f->max_rank*sizeof(int));
+    memcpy(f->A, A, (size_t)n*n*sizeof(double));
+    refactor(f);
+    f->refactors = 0;
+    return f->info;
+}
+
+int lu_upd_update(lu_updatable* f, const double U[], const double V[], int k) {
+    int i, r, n = f->n, w = f->max_rank, r0, refactored = 0;
+    double* T;
+
+    if (k > w) {
+        /* Wider than the whole budget: straight into A */
+        add_outer(f->A, n, U, V, k, k, f->thread_count);
+        refactor(f);
+        return 1;
+    }
+    if (f->rank + k > w) {
+        refactor(f);
+        refactored = 1;
+    }
+
+    r0 = f->rank;
+    T = malloc((size_t)n*k*sizeof(double));
+    memcpy(T, U, (size_t)n*k*sizeof(double));
+    lu_solve_many(f->LU, f->piv, n, T, k, f->nb, f->thread_count);
+    for (i = 0; i < n; i++)
+        for (r = 0; r < k; r++) {
+            f->U[(size_t)i*w+r0+r] = U[(size_t)i*k+r];
+            f->V[(size_t)i*w+r0+r] = V[(size_t)i*k+r];
+            f->Z[(size_t)i*w+r0+r] = T[(size_t)i*k+r];
+        }
+    free(T);
+    f->rank += k;
+
+    if (!build_capacitance(f)) {
+        refactor(f);
+        return 1;
+    }
+    return refactored;
+}
+
+void lu_upd_solve(lu_updatable* f, double b[]) {
+    int i, r, n = f->n, w = f->max_rank, k = f->rank;
+    double* t;
+
+    lu_solve(f->LU, f->piv, n, b, f->nb, f->thread_count);
+    if (k == 0) return;
+
+    /* b -= Z C^-1 V^T b */
+    t = calloc(k, sizeof(double));
+    for (i = 0; i < n; i++)
+        for (r = 0; r < k; r++)
+            t[r] += f->V[(size_t)i*w+r]*b[i];
+    lu_solve(f->C, f->cpiv, k, t, LU_DEFAULT_BLOCK, 1);
+#   pragma omp parallel for num_threads(f->thread_count) \
+        default(none) private(r) shared(f, n, w, k, b, t)
+    for (i = 0; i < n; i++)
+        for (r = 0; r < k; r++)
+            b[i] -= f->Z[(size_t)i*w+r]*t[r];
+    free(t);
+}
+
+void lu_upd_free(lu_updatable* f) {
+    free(f->A);
+    free(f->LU);
+    free(f->piv);
+    free(f->U);
+    free(f->V);
+    free(f->Z);
+    free(f->C);
+    free(f->cpiv);
+}
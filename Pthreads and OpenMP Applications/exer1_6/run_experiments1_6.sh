@@ -3,11 +3,17 @@
 # Specify the range of inputs and threads to test
 n_values=(500 1000 2000 5000 8000 10000)
 thread_values=(1 2 4)
-approaches=(0 1)
+# 0 serial, 1 parallel, 2 blocked LU with partial pivoting, 3 task DAG LU,
+# 4 mixed precision LU with iterative refinement, 5 out-of-core LU
+approaches=(0 1 2 3 4 5)
 
 # Specify the number of times to run the program for each input and thread count
 num_runs=5
 
+# The task DAG LU (approach 3) gives panels and the next panel's column
+# block priority 1; OpenMP ignores task priorities above this limit
+export OMP_MAX_TASK_PRIORITY=1
+
 
 for n in "${n_values[@]}"; do
     for approach in "${approaches[@]}"; do
@@ -23,4 +29,66 @@ for n in "${n_values[@]}"; do
             done
         done
     done
-done
\ No newline at end of file
+done
+
+# Factor once, solve many: blocked LU with k right-hand sides
+rhs_values=(1 10 100)
+for n in "${n_values[@]}"; do
+    for nrhs in "${rhs_values[@]}"; do
+        for thread_count in "${thread_values[@]}"; do
+            for ((i = 1; i <= num_runs; i++)); do
+                ./exercise1_6 -k $nrhs $thread_count $n 2
+            done
+        done
+    done
+done
+
+# Banded systems: band LU by bandwidth.  Band storage takes
+# n*(3*bandwidth+1) doubles, about 0.6 GB at n = 100000 and bandwidth 256
+band_n_values=(10000 50000 100000)
+bandwidth_values=(4 16 64 256)
+for n in "${band_n_values[@]}"; do
+    for bandwidth in "${bandwidth_values[@]}"; do
+        for thread_count in "${thread_values[@]}"; do
+            # The band LU stays serial below BAND_PAR_MIN (lu_band.c), i.e.
+            # while 2*bandwidth^2 < 4096, so -w 4 and -w 16 run on one thread
+            if [ "$thread_count" -ne 1 ] && [ $((2*bandwidth*bandwidth)) -lt 4096 ]; then
+                continue
+            fi
+            for ((i = 1; i <= num_runs; i++)); do
+                ./exercise1_6 -w $bandwidth $thread_count $n 6
+            done
+        done
+    done
+done
+
+# Low-rank updates: Sherman-Morrison-Woodbury solves against refactoring
+update_n_values=(1000 2000 5000)
+update_rank_values=(1 4 16)
+for n in "${update_n_values[@]}"; do
+    for rank in "${update_rank_values[@]}"; do
+        for thread_count in "${thread_values[@]}"; do
+            for ((i = 1; i <= num_runs; i++)); do
+                ./exercise1_6 -u $rank -r 20 $thread_count $n 7
+            done
+        done
+    done
+done
+
+# Resident solver: one daemon per thread count, loaded by the client
+service_n_values=(1000 2000 5000)
+connection_values=(1 2 4 8)
+for thread_count in "${thread_values[@]}"; do
+    ./solverd1_6 $thread_count &
+    sleep 1
+    for n in "${service_n_values[@]}"; do
+        for connections in "${connection_values[@]}"; do
+            for nrhs in 1 16; do
+                ./solver_client1_6 -k $nrhs $connections $n
+                ./solver_client1_6 -z -k $nrhs $connections $n
+            done
+        done
+    done
+    ./solver_client1_6 -x -r 1 1 10
+    wait
+done
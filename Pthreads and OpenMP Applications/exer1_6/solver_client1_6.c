@@ -0,0 +1,368 @@
+/* File:     solver_client1_6.c
+ *
+ * Purpose:  Client and load generator for solverd1_6: load a random
+ *           matrix, factor it once, then have several connections send
+ *           solve requests back to back and measure their latency and
+ *           the throughput of the daemon
+ *
+ * Compile:  make all  (needs timer.h, my_rand.h and solver_proto.h)
+ *
+ * Usage:    ./solver_client1_6 [-s socket_path] [-z] [-k nrhs] [-r requests] [-c] [-x] <connections> <linear_system_size>
+ *
+ * Input:    Number of connections, each with its own thread
+ *           Size n of the linear system
+ *           -s: socket of the daemon (default SOLVER_SOCKET)
+ *           -z: pass matrices and right-hand sides in shared memory
+ *           instead of through the socket
+ *           -k: right-hand sides per solve request (default 1)
+ *           -r: solve requests per connection (default 100)
+ *           -c: check the residual of one solve
+ *           -x: shut the daemon down at the end
+ *
+ * Output:   Load and factorisation times, requests/sec, the mean, median
+ *           and 99th percentile latency and the mean time the daemon
+ *           spent per request.  Appended to Service1_6.csv as
+ *           n,connections,nrhs,transport,requests,throughput,mean,p50,p99
+ *           (latencies in seconds)
+ *
+ * Notes:
+ *    1.  Latency is from sending a request to having its reply, so with
+ *        -z it excludes writing the right-hand sides, which the client
+ *        does in the shared buffer before sending.
+ *    2.  The matrix is loaded into slot 0, which is freed at the end.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include "../timer.h"
+#include "../my_rand.h"
+#include "solver_proto.h"
+
+/* Mark of an I/O failure, apart from the solver_status codes */
+#define IO_ERROR -100
+
+/*Global variables*/
+int connections, n, nrhs = 1, requests = 100, use_shm = 0, check = 0,
+    shutdown_daemon = 0;
+char* socket_path = SOLVER_SOCKET;
+double* latencies;          /* requests per connection, connection by connection */
+double* server_times;
+
+void Usage(char* prog_name);
+void Get_args(int argc, char* argv[]);
+int Connect(void);
+double* Attach(int fd, long rank, size_t size);
+int Request(int fd, solver_request* req, const void* payload,
+            solver_reply* rep, void* out);
+void Check(int status, const char* what);
+void* Load_generator(void* rank);
+int Compare_doubles(const void* a, const void* b);
+double Residual(double A[], double b[], double x[]);
+
+int main(int argc, char* argv[]) {
+    double *A, *b, *x, *shm = NULL;
+    double start, finish, elapsed, sum = 0.0, server_sum = 0.0;
+    solver_request req;
+    solver_reply rep;
+    pthread_t* thread_handles;
+    long thread, total;
+    unsigned seed = 1;
+    int fd, i, j;
+
+    Get_args(argc, argv);
+    FILE *fp = fopen("Service1_6.csv", "a");
+    if (fp == NULL) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    fd = Connect();
+    if (use_shm) {
+        shm = Attach(fd, -1, (size_t)n*n*sizeof(double));
+        A = shm;
+    } else {
+        A = malloc((size_t)n*n*sizeof(double));
+    }
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++) {
+            A[(size_t)i*n+j] = (double) my_rand(&seed);
+            while (A[(size_t)i*n+j] == 0.0 && i == j)
+                A[(size_t)i*n+j] = (double) my_rand(&seed);
+        }
+
+    memset(&req, 0, sizeof(req));
+    req.op = SOLVER_LOAD;
+    req.flags = use_shm ? SOLVER_IN_SHM : 0;
+    req.n = n;
+    req.length = (size_t)n*n*sizeof(double);
+    GET_TIME(start);
+    Check(Request(fd, &req, A, &rep, NULL), "Load");
+    GET_TIME(finish);
+    printf("Load: %e seconds\n", finish-start);
+
+    req.op = SOLVER_FACTOR;
+    req.flags = 0;
+    req.length = 0;
+    GET_TIME(start);
+    Check(Request(fd, &req, NULL, &rep, NULL), "Factor");
+    GET_TIME(finish);
+    printf("Factor: %e seconds (daemon %e)\n", finish-start, rep.time);
+
+    if (check) {
+        /* One inline solve, checked against the matrix */
+        b = malloc(n*sizeof(double));
+        x = malloc(n*sizeof(double));
+        for (i = 0; i < n; i++)
+            b[i] = (double) my_rand(&seed);
+        req.op = SOLVER_SOLVE;
+        req.nrhs = 1;
+        req.length = n*sizeof(double);
+        Check(Request(fd, &req, b, &rep, x), "Solve");
+        printf("Relative residual: %e\n", Residual(A, b, x));
+        free(b);
+        free(x);
+    }
+
+    latencies = malloc((size_t)connections*requests*sizeof(double));
+    server_times = malloc((size_t)connections*requests*sizeof(double));
+    thread_handles = malloc(connections*sizeof(pthread_t));
+    GET_TIME(start);
+    for (thread = 0; thread < connections; thread++)
+        pthread_create(&thread_handles[thread], NULL, Load_generator,
+                       (void*) thread);
+    for (thread = 0; thread < connections; thread++)
+        pthread_join(thread_handles[thread], NULL);
+    GET_TIME(finish);
+    elapsed = finish - start;
+
+    total = (long)connections*requests;
+    for (i = 0; i < total; i++) {
+        sum += latencies[i];
+        server_sum += server_times[i];
+    }
+    qsort(latencies, total, sizeof(double), Compare_doubles);
+    printf("%ld solves of %d right-hand sides over %d connections (%s): "
+           "%e seconds\n", total, nrhs, connections,
+           use_shm ? "shared memory" : "socket", elapsed);
+    printf("Throughput: %.1f requests/sec, %.1f right-hand sides/sec\n",
+           total/elapsed, total*nrhs/elapsed);
+    printf("Latency: mean %e, p50 %e, p99 %e seconds; daemon time %e\n",
+           sum/total, latencies[total/2], latencies[(long)(0.99*(total-1))],
+           server_sum/total);
+    fprintf(fp, "%d,%d,%d,%s,%ld,%e,%e,%e,%e\n", n, connections, nrhs,
+            use_shm ? "shm" : "socket", total, total/elapsed, sum/total,
+            latencies[total/2], latencies[(long)(0.99*(total-1))]);
+
+    req.op = SOLVER_FREE;
+    req.length = 0;
+    Check(Request(fd, &req, NULL, &rep, NULL), "Free");
+    if (shutdown_daemon) {
+        req.op = SOLVER_SHUTDOWN;
+        Check(Request(fd, &req, NULL, &rep, NULL), "Shutdown");
+    }
+
+    close(fd);
+    fclose(fp);
+    if (use_shm) munmap(shm, (size_t)n*n*sizeof(double));
+    else free(A);
+    free(latencies);
+    free(server_times);
+    free(thread_handles);
+    return 0;
+}
+
+/* One connection sending solve requests back to back */
+void* Load_generator(void* rank) {
+    long my_rank = (long) rank;
+    size_t size = (size_t)n*nrhs*sizeof(double);
+    unsigned seed = my_rank + 2;
+    double *B, *X, start, finish;
+    solver_request req;
+    solver_reply rep;
+    int fd, r, i;
+
+    fd = Connect();
+    if (use_shm) {
+        /* The solutions come back in place */
+        B = X = Attach(fd, my_rank, size);
+    } else {
+        B = malloc(size);
+        X = malloc(size);
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.op = SOLVER_SOLVE;
+    req.flags = use_shm ? SOLVER_IN_SHM : 0;
+    req.n = n;
+    req.nrhs = nrhs;
+    req.length = size;
+    for (r = 0; r < requests; r++) {
+        for (i = 0; i < n*nrhs; i++)
+            B[i] = (double) my_rand(&seed);
+        GET_TIME(start);
+        Check(Request(fd, &req, B, &rep, X), "Solve");
+        GET_TIME(finish);
+        latencies[my_rank*requests + r] = finish - start;
+        server_times[my_rank*requests + r] = rep.time;
+    }
+
+    close(fd);
+    if (use_shm) {
+        munmap(B, size);
+    } else {
+        free(B);
+        free(X);
+    }
+    return NULL;
+}
+
+int Connect(void) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        perror("Error connecting to the daemon");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/* Create a shared buffer of size bytes and attach it to the connection.
+ * Once the daemon has mapped it the name is no longer needed. */
+double* Attach(int fd, long rank, size_t size) {
+    char name[64];
+    solver_request req;
+    solver_reply rep;
+    double* shm;
+    int shm_fd;
+
+    snprintf(name, sizeof(name), "/solver1_6.%d.%ld", (int) getpid(), rank);
+    shm_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (shm_fd < 0 || ftruncate(shm_fd, size) < 0) {
+        perror("Error creating shared memory");
+        exit(EXIT_FAILURE);
+    }
+    shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (shm == MAP_FAILED) {
+        perror("Error mapping shared memory");
+        shm_unlink(name);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.op = SOLVER_ATTACH;
+    req.length = strlen(name);
+    Check(Request(fd, &req, name, &rep, NULL), "Attach");
+    shm_unlink(name);
+    return shm;
+}
+
+/* Send req with its inline payload, wait for the reply and read its
+ * payload into out.  Returns the status, or IO_ERROR. */
+int Request(int fd, solver_request* req, const void* payload,
+            solver_reply* rep, void* out) {
+    if (solver_write(fd, req, sizeof(*req)) != 0)
+        return IO_ERROR;
+    if (!(req->flags & SOLVER_IN_SHM) && req->length > 0 &&
+        solver_write(fd, payload, req->length) != 0)
+        return IO_ERROR;
+    if (solver_read(fd, rep, sizeof(*rep)) != 0)
+        return IO_ERROR;
+    if (rep->length > 0 &&
+        (out == NULL || rep->length > req->length ||
+         solver_read(fd, out, rep->length) != 0))
+        return IO_ERROR;
+    return rep->status;
+}
+
+void Check(int status, const char* what) {
+    static const char* messages[] = { "ok", "invalid request",
+        "no such matrix", "matrix not factored", "matrix is singular",
+        "out of memory", "shared memory unavailable" };
+
+    if (status == SOLVER_OK) return;
+    if (status == IO_ERROR)
+        fprintf(stderr, "%s: lost the connection to the daemon\n", what);
+    else if (status < 0 && -status < sizeof(messages)/sizeof(messages[0]))
+        fprintf(stderr, "%s: %s\n", what, messages[-status]);
+    else
+        fprintf(stderr, "%s: status %d\n", what, status);
+    exit(EXIT_FAILURE);
+}
+
+int Compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/* ||Ax-b||_inf / (||A||_inf ||x||_inf + ||b||_inf) */
+double Residual(double A[], double b[], double x[]) {
+    int i, j;
+    double r, row_sum, r_max = 0.0, a_max = 0.0, x_max = 0.0, b_max = 0.0;
+
+    for (i = 0; i < n; i++) {
+        r = -b[i];
+        row_sum = 0.0;
+        for (j = 0; j < n; j++) {
+            r += A[(size_t)i*n+j]*x[j];
+            row_sum += fabs(A[(size_t)i*n+j]);
+        }
+        if (fabs(r) > r_max) r_max = fabs(r);
+        if (row_sum > a_max) a_max = row_sum;
+        if (fabs(x[i]) > x_max) x_max = fabs(x[i]);
+        if (fabs(b[i]) > b_max) b_max = fabs(b[i]);
+    }
+    return r_max / (a_max*x_max + b_max);
+}
+
+void Get_args(int argc, char* argv[]) {
+    int opt;
+    char* program_name = argv[0];
+
+    while ((opt = getopt(argc, argv, "s:zk:r:cx")) != -1) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            case 'z': use_shm = 1; break;
+            case 'k': nrhs = strtol(optarg, NULL, 10); break;
+            case 'r': requests = strtol(optarg, NULL, 10); break;
+            case 'c': check = 1; break;
+            case 'x': shutdown_daemon = 1; break;
+            default: Usage(program_name);
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc != 3) {
+        Usage(program_name);
+    }
+    connections = strtol(argv[1], NULL, 10);
+    n = strtol(argv[2], NULL, 10);
+    if (connections <= 0 || n <= 0 || nrhs <= 0 || requests <= 0) {
+        Usage(program_name);
+    }
+}
+
+void Usage(char* program_name) {
+    fprintf(stderr, "Usage: %s [-s socket_path] [-z] [-k nrhs] [-r requests] [-c] [-x] <connections> <linear_system_size>\n"
+                    "       <connections> must be positive\n"
+                    "       <linear_system_size> must be positive\n"
+                    "       -s sets the socket of the daemon (default %s)\n"
+                    "       -z passes payloads in shared memory\n"
+                    "       -k sets the right-hand sides per solve request\n"
+                    "       -r sets the solve requests per connection\n"
+                    "       -c checks the residual of one solve\n"
+                    "       -x shuts the daemon down at the end\n",
+                    program_name, SOLVER_SOCKET);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,86 @@
+#ifndef SOLVER_PROTO_H
+#define SOLVER_PROTO_H
+
+#include <stdint.h>
+#include <unistd.h>
+
+/* Wire protocol between solverd1_6 and solver_client1_6.  Every message
+ * is a fixed header, followed by length bytes of payload when the
+ * payload travels inline.  Both ends run on the same host, so fields
+ * are in host byte order.  Matrices and right-hand sides are row-major
+ * doubles: n x n for a matrix, n x nrhs for the right-hand sides. */
+
+#define SOLVER_SOCKET "/tmp/solverd1_6.sock"
+
+/* Matrix slots the daemon keeps */
+#define SOLVER_MAX_MATRICES 16
+
+/* Largest payload sent inline; bigger ones go through shared memory */
+#define SOLVER_MAX_PAYLOAD ((uint64_t)1 << 32)
+
+typedef enum {
+    SOLVER_ATTACH = 1,      /* payload: name of a POSIX shared memory object */
+    SOLVER_LOAD,            /* payload: the n x n matrix for slot matrix */
+    SOLVER_FACTOR,          /* LU factorise slot matrix */
+    SOLVER_SOLVE,           /* payload: n x nrhs, replaced by the solutions */
+    SOLVER_FREE,            /* drop slot matrix */
+    SOLVER_SHUTDOWN         /* stop the daemon */
+} solver_op;
+
+/* The payload is at offset in the buffer given by SOLVER_ATTACH and not
+ * on the socket.  SOLVER_SOLVE writes the solutions back there, so a
+ * solve moves no data through the socket at all. */
+#define SOLVER_IN_SHM 1u
+
+typedef struct {
+    uint32_t op, flags;
+    uint32_t matrix, n, nrhs, reserved;
+    uint64_t offset;        /* of the payload in the shared buffer */
+    uint64_t length;        /* payload bytes */
+} solver_request;
+
+typedef enum {
+    SOLVER_OK = 0,
+    SOLVER_EINVAL = -1,     /* malformed request or payload out of range */
+    SOLVER_ENOMATRIX = -2,  /* slot empty or of a different n */
+    SOLVER_ENOTFACTORED = -3,
+    SOLVER_ESINGULAR = -4,
+    SOLVER_ENOMEM = -5,
+    SOLVER_ESHM = -6        /* no shared buffer, or it could not be mapped */
+} solver_status;
+
+typedef struct {
+    int32_t status;
+    uint32_t reserved;
+    uint64_t length;        /* inline payload bytes that follow */
+    double time;            /* seconds the daemon spent on the request */
+} solver_reply;
+
+/* Read or write exactly len bytes; return 0, or -1 on error or EOF */
+static inline int solver_read(int fd, void* buf, size_t len) {
+    char* p = buf;
+    ssize_t got;
+
+    while (len > 0) {
+        got = read(fd, p, len);
+        if (got <= 0) return -1;
+        p += got;
+        len -= got;
+    }
+    return 0;
+}
+
+static inline int solver_write(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    ssize_t put;
+
+    while (len > 0) {
+        put = write(fd, p, len);
+        if (put <= 0) return -1;
+        p += put;
+        len -= put;
+    }
+    return 0;
+}
+
+#endif // SOLVER_PROTO_H
@@ -0,0 +1,487 @@
+/* File:     solverd1_6.c
+ *
+ * Purpose:  Resident linear solver: keep matrices, their LU factors and
+ *           one compute thread with its OpenMP team alive between
+ *           requests, so clients pay for a solve and not for process
+ *           startup, thread creation, matrix generation and allocation
+ *           each time
+ *
+ * Compile:  make all  (needs timer.h and solver_proto.h)
+ *
+ * Usage:    ./solverd1_6 [-s socket_path] [-b block_size] <thread_count>
+ *
+ * Input:    Number of threads of each factorisation and solve
+ *           -s: Unix domain socket to listen on (default SOLVER_SOCKET)
+ *           -b: panel width of the blocked LU (default 64)
+ *
+ * Output:   A line when listening, and the connections and requests
+ *           served at shutdown
+ *
+ * Notes:
+ *    1.  Requests are described in solver_proto.h.  Each connection is
+ *        served by its own thread, which only does the socket I/O;
+ *        requests on one connection are handled in order.
+ *    2.  Factorisations and solves are queued for the compute thread,
+ *        which runs them one at a time on all thread_count threads of
+ *        its OpenMP team.  That team is started once and reused, so the
+ *        daemon's threads stay the same however many clients connect.
+ *    3.  Every slot has a read-write lock: loading and freeing, done by
+ *        the connection threads, take it alone.
+ *    4.  A client may attach a shared memory object.  Payloads in it
+ *        are read in place, and solves overwrite the right-hand sides
+ *        there, so only the headers go through the socket.
+ *    5.  SIGINT, SIGTERM or a SOLVER_SHUTDOWN request stop the daemon.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <omp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../timer.h"
+#include "lu.h"
+#include "solver_proto.h"
+
+typedef struct {
+    pthread_rwlock_t lock;
+    int n, factored;
+    double *A, *LU;
+    int* piv;
+} slot_t;
+
+/* A factorisation or solve waiting for the compute thread */
+typedef struct job {
+    solver_request* req;
+    double* B;
+    int status, done;
+    struct job* next;
+} job_t;
+
+/*Global variables*/
+int thread_count, block_size = LU_DEFAULT_BLOCK;
+char* socket_path = SOLVER_SOCKET;
+int listen_fd;
+volatile sig_atomic_t stopping = 0;
+slot_t slots[SOLVER_MAX_MATRICES];
+long connections = 0, requests = 0;
+pthread_mutex_t count_mutex = PTHREAD_MUTEX_INITIALIZER;
+job_t *job_head = NULL, *job_tail = NULL;
+int compute_stopping = 0;
+pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+
+void Usage(char* prog_name);
+void Get_args(int argc, char* argv[]);
+void Stop(int sig);
+void* Serve(void* fd_p);
+int Drain(int fd, uint64_t length);
+int Check(solver_request* req);
+int Handle(solver_request* req, char* buf, char* shm, size_t shm_size,
+           size_t* out_len);
+void* Compute(void* unused);
+int Run(solver_request* req, double B[]);
+int Load(solver_request* req, const double A[]);
+int Factor(solver_request* req);
+int Solve(solver_request* req, double B[]);
+void Free_slot(int matrix);
+
+int main(int argc, char* argv[]) {
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    pthread_t thread, compute;
+    int m, fd, *fd_p;
+
+    Get_args(argc, argv);
+    for (m = 0; m < SOLVER_MAX_MATRICES; m++) {
+        pthread_rwlock_init(&slots[m].lock, NULL);
+        slots[m].A = slots[m].LU = NULL;
+        slots[m].piv = NULL;
+        slots[m].n = slots[m].factored = 0;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = Stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("Error creating socket");
+        exit(EXIT_FAILURE);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, 64) < 0) {
+        perror("Error binding socket");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pthread_create(&compute, NULL, Compute, NULL) != 0) {
+        perror("Error creating compute thread");
+        exit(EXIT_FAILURE);
+    }
+    printf("solverd1_6: listening on %s with %d threads\n", socket_path,
+           thread_count);
+    fflush(stdout);
+
+    while (!stopping) {
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;   /* EINTR, or shutdown() by Stop */
+        fd_p = malloc(sizeof(int));
+        *fd_p = fd;
+        if (pthread_create(&thread, NULL, Serve, fd_p) != 0) {
+            close(fd);
+            free(fd_p);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    pthread_mutex_lock(&job_mutex);
+    compute_stopping = 1;
+    pthread_cond_signal(&job_ready);
+    pthread_mutex_unlock(&job_mutex);
+    pthread_join(compute, NULL);
+    printf("solverd1_6: %ld connections, %ld requests\n", connections, requests);
+    /* Connections still open get SOLVER_ENOMATRIX from here on */
+    for (m = 0; m < SOLVER_MAX_MATRICES; m++) {
+        pthread_rwlock_wrlock(&slots[m].lock);
+        Free_slot(m);
+        pthread_rwlock_unlock(&slots[m].lock);
+    }
+    return 0;
+}
+
+/* Wake accept, which returns an error once the socket is shut down */
+void Stop(int sig) {
+    (void) sig;
+    stopping = 1;
+    shutdown(listen_fd, SHUT_RDWR);
+}
+
+/* One connection: read a request, handle it, reply, until EOF */
+void* Serve(void* fd_p) {
+    int fd = *(int*) fd_p;
+    solver_request req;
+    solver_reply rep;
+    char *buf = NULL, *shm = NULL, name[256];
+    size_t cap = 0, shm_size = 0, out_len;
+    struct stat st;
+    double start, finish;
+    long served = 0;
+    int shm_fd, shutting_down = 0;
+
+    free(fd_p);
+    pthread_mutex_lock(&count_mutex);
+    connections++;
+    pthread_mutex_unlock(&count_mutex);
+
+    while (solver_read(fd, &req, sizeof(req)) == 0) {
+        GET_TIME(start);
+        out_len = 0;
+        if (req.op == SOLVER_ATTACH && req.length >= sizeof(name)) {
+            /* No such name: skip it to stay in step with the client */
+            rep.status = SOLVER_EINVAL;
+            if (Drain(fd, req.length) != 0) break;
+        } else if (req.op == SOLVER_ATTACH) {
+            rep.status = SOLVER_ESHM;
+            if (solver_read(fd, name, req.length) == 0) {
+                name[req.length] = '\0';
+                if (shm != NULL) munmap(shm, shm_size);
+                shm = NULL;
+                shm_fd = shm_open(name, O_RDWR, 0);
+                if (shm_fd >= 0 && fstat(shm_fd, &st) == 0 && st.st_size > 0) {
+                    shm_size = st.st_size;
+                    shm = mmap(NULL, shm_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED, shm_fd, 0);
+                    if (shm == MAP_FAILED) shm = NULL;
+                    else rep.status = SOLVER_OK;
+                }
+                if (shm_fd >= 0) close(shm_fd);
+            } else {
+                break;
+            }
+        } else if (req.op == SOLVER_SHUTDOWN) {
+            rep.status = SOLVER_OK;
+        } else if (!(req.flags & SOLVER_IN_SHM) && req.length > 0) {
+            /* Inline payload: into the connection's buffer, once the
+             * header says it is worth the memory */
+            rep.status = Check(&req);
+            if (rep.status == SOLVER_OK && req.length > cap) {
+                free(buf);
+                buf = malloc(req.length);
+                cap = (buf == NULL) ? 0 : req.length;
+                if (buf == NULL) rep.status = SOLVER_ENOMEM;
+            }
+            if (rep.status != SOLVER_OK) {
+                if (Drain(fd, req.length) != 0) break;
+            } else {
+                if (solver_read(fd, buf, req.length) != 0) break;
+                rep.status = Handle(&req, buf, shm, shm_size, &out_len);
+            }
+        } else {
+            rep.status = Handle(&req, buf, shm, shm_size, &out_len);
+        }
+        GET_TIME(finish);
+
+        rep.reserved = 0;
+        rep.length = out_len;
+        rep.time = finish - start;
+        if (solver_write(fd, &rep, sizeof(rep)) != 0 ||
+            (out_len > 0 && solver_write(fd, buf, out_len) != 0))
+            break;
+        served++;
+        if (req.op == SOLVER_SHUTDOWN) {
+            shutting_down = 1;
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&count_mutex);
+    requests += served;
+    pthread_mutex_unlock(&count_mutex);
+    if (shutting_down) Stop(0);
+    if (shm != NULL) munmap(shm, shm_size);
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+/* Skip length bytes of payload to stay in step with the client */
+int Drain(int fd, uint64_t length) {
+    char chunk[4096];
+    uint64_t done, len;
+
+    for (done = 0; done < length; done += len) {
+        len = length - done < sizeof(chunk) ? length - done : sizeof(chunk);
+        if (solver_read(fd, chunk, len) != 0) return -1;
+    }
+    return 0;
+}
+
+/* Check the header of a request that carries a matrix or right-hand
+ * sides: the payload must be exactly the n x n or n x nrhs doubles it
+ * describes, and inline at most SOLVER_MAX_PAYLOAD bytes */
+int Check(solver_request* req) {
+    size_t cols;
+
+    if (req->op != SOLVER_LOAD && req->op != SOLVER_SOLVE) return SOLVER_EINVAL;
+    /* Sizes must fit the int of the LU routines */
+    if (req->matrix >= SOLVER_MAX_MATRICES || req->n > INT_MAX ||
+        req->nrhs > INT_MAX)
+        return SOLVER_EINVAL;
+    if (req->n == 0 || (req->op == SOLVER_SOLVE && req->nrhs == 0))
+        return SOLVER_EINVAL;
+    cols = (req->op == SOLVER_LOAD) ? req->n : req->nrhs;
+    if (cols > SIZE_MAX/sizeof(double)/req->n ||
+        req->length != (uint64_t)req->n*cols*sizeof(double))
+        return SOLVER_EINVAL;
+    if (!(req->flags & SOLVER_IN_SHM) && req->length > SOLVER_MAX_PAYLOAD)
+        return SOLVER_EINVAL;
+    return SOLVER_OK;
+}
+
+/* Check the request against its payload, find the payload, and run it.
+ * An inline solve leaves its solutions in buf for the reply. */
+int Handle(solver_request* req, char* buf, char* shm, size_t shm_size,
+           size_t* out_len) {
+    char* payload = buf;
+    size_t need;
+    int status;
+
+    if (req->matrix >= SOLVER_MAX_MATRICES || req->n > INT_MAX)
+        return SOLVER_EINVAL;
+    if (req->op == SOLVER_FACTOR) return Run(req, NULL);
+    if (req->op == SOLVER_FREE) {
+        pthread_rwlock_wrlock(&slots[req->matrix].lock);
+        Free_slot(req->matrix);
+        pthread_rwlock_unlock(&slots[req->matrix].lock);
+        return SOLVER_OK;
+    }
+
+    status = Check(req);
+    if (status != SOLVER_OK) return status;
+    need = req->length;
+    if (req->flags & SOLVER_IN_SHM) {
+        if (shm == NULL) return SOLVER_ESHM;
+        if (req->offset > shm_size || need > shm_size - req->offset ||
+            req->offset % sizeof(double) != 0)
+            return SOLVER_EINVAL;
+        payload = shm + req->offset;
+    }
+
+    if (req->op == SOLVER_LOAD) return Load(req, (double*) payload);
+    if (!(req->flags & SOLVER_IN_SHM)) *out_len = need;
+    return Run(req, (double*) payload);
+}
+
+/* Hand a factorisation (B NULL) or solve to the compute thread and wait */
+int Run(solver_request* req, double B[]) {
+    job_t job = { req, B, SOLVER_OK, 0, NULL };
+
+    pthread_mutex_lock(&job_mutex);
+    if (compute_stopping) {
+        pthread_mutex_unlock(&job_mutex);
+        return SOLVER_ENOMATRIX;
+    }
+    if (job_tail == NULL) job_head = &job;
+    else job_tail->next = &job;
+    job_tail = &job;
+    pthread_cond_signal(&job_ready);
+    while (!job.done)
+        pthread_cond_wait(&job_done, &job_mutex);
+    pthread_mutex_unlock(&job_mutex);
+    return job.status;
+}
+
+/* The compute thread: starts its OpenMP team once, then runs the queued
+ * jobs on it until the daemon stops and the queue is empty */
+void* Compute(void* unused) {
+    job_t* job;
+
+    (void) unused;
+#   pragma omp parallel num_threads(thread_count)
+    { }
+
+    pthread_mutex_lock(&job_mutex);
+    for (;;) {
+        while (job_head == NULL && !compute_stopping)
+            pthread_cond_wait(&job_ready, &job_mutex);
+        if (job_head == NULL) break;
+        job = job_head;
+        job_head = job->next;
+        if (job_head == NULL) job_tail = NULL;
+        pthread_mutex_unlock(&job_mutex);
+
+        job->status = (job->B == NULL) ? Factor(job->req)
+                                       : Solve(job->req, job->B);
+
+        pthread_mutex_lock(&job_mutex);
+        job->done = 1;
+        pthread_cond_broadcast(&job_done);
+    }
+    pthread_mutex_unlock(&job_mutex);
+    return NULL;
+}
+
+/* Copy the matrix into the slot, reusing its storage if n is the same */
+int Load(solver_request* req, const double A[]) {
+    slot_t* s = &slots[req->matrix];
+    int n = req->n, status = SOLVER_OK;
+
+    pthread_rwlock_wrlock(&s->lock);
+    if (s->n != n) {
+        Free_slot(req->matrix);
+        s->A = malloc((size_t)n*n*sizeof(double));
+        s->LU = malloc((size_t)n*n*sizeof(double));
+        s->piv = malloc(n*sizeof(int));
+        if (s->A == NULL || s->LU == NULL || s->piv == NULL) {
+            Free_slot(req->matrix);
+            status = SOLVER_ENOMEM;
+        } else {
+            s->n = n;
+        }
+    }
+    if (status == SOLVER_OK) {
+        memcpy(s->A, A, (size_t)n*n*sizeof(double));
+        s->factored = 0;
+    }
+    pthread_rwlock_unlock(&s->lock);
+    return status;
+}
+
+int Factor(solver_request* req) {
+    slot_t* s = &slots[req->matrix];
+    int n = req->n, status = SOLVER_OK;
+
+    pthread_rwlock_wrlock(&s->lock);
+    if (s->n == 0 || (n != 0 && n != s->n)) {
+        status = SOLVER_ENOMATRIX;
+    } else {
+        memcpy(s->LU, s->A, (size_t)s->n*s->n*sizeof(double));
+        if (lu_factor(s->LU, s->n, s->piv, block_size, thread_count) != 0) {
+            s->factored = 0;
+            status = SOLVER_ESINGULAR;
+        } else {
+            s->factored = 1;
+        }
+    }
+    pthread_rwlock_unlock(&s->lock);
+    return status;
+}
+
+int Solve(solver_request* req, double B[]) {
+    slot_t* s = &slots[req->matrix];
+    int n = req->n, status = SOLVER_OK;
+
+    pthread_rwlock_rdlock(&s->lock);
+    if (s->n == 0 || n != s->n)
+        status = SOLVER_ENOMATRIX;
+    else if (!s->factored)
+        status = SOLVER_ENOTFACTORED;
+    else if (req->nrhs == 1)
+        lu_solve(s->LU, s->piv, s->n, B, block_size, thread_count);
+    else
+        lu_solve_many(s->LU, s->piv, s->n, B, req->nrhs, block_size,
+                      thread_count);
+    pthread_rwlock_unlock(&s->lock);
+    return status;
+}
+
+/* Caller holds the slot's write lock */
+void Free_slot(int matrix) {
+    slot_t* s = &slots[matrix];
+
+    free(s->A);
+    free(s->LU);
+    free(s->piv);
+    s->A = s->LU = NULL;
+    s->piv = NULL;
+    s->n = s->factored = 0;
+}
+
+void Get_args(int argc, char* argv[]) {
+    int opt;
+    char* program_name = argv[0];
+
+    while ((opt = getopt(argc, argv, "s:b:")) != -1) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            case 'b': block_size = strtol(optarg, NULL, 10); break;
+            default: Usage(program_name);
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc != 2) {
+        Usage(program_name);
+    }
+    thread_count = strtol(argv[1], NULL, 10);
+    if (thread_count <= 0 || block_size <= 0) {
+        Usage(program_name);
+    }
+}
+
+void Usage(char* program_name) {
+    fprintf(stderr, "Usage: %s [-s socket_path] [-b block_size] <thread_count>\n"
+                    "       <thread_count> must be positive\n"
+                    "       -s sets the socket to listen on (default %s)\n"
+                    "       -b sets the blocked LU panel width\n",
+                    program_name, SOLVER_SOCKET);
+    exit(EXIT_FAILURE);
+}